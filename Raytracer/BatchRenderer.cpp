@@ -0,0 +1,202 @@
+#include "BatchRenderer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include "Camera.h"
+#include "FrameBuffer.h"
+#include "Tile.h"
+
+namespace {
+
+// A view being rendered: the frame buffer lives until the view's last tile is done.
+struct ViewJob
+{
+    ViewJob(const BatchView& view)
+            : camera(view.lookFrom, view.lookAt, view.up, view.vFov,
+                     float(view.imageWidth) / float(view.imageHeight), view.aperture, view.focusDistance),
+              frameBuffer(new FrameBuffer(view.imageWidth, view.imageHeight, false)),
+              nbrOfRemainingTiles(0)
+    { }
+
+    Camera camera;
+    std::unique_ptr<FrameBuffer> frameBuffer;
+    std::atomic<uint> nbrOfRemainingTiles;
+};
+
+// More views are queued while fewer than this many tiles per thread are queued or rendering, and
+// while the unfinished views' frame buffers hold fewer than MAX_PIXELS_IN_FLIGHT pixels (about
+// 200 MB); a view bigger than that is only queued once every earlier view is done.
+const uint TILES_IN_FLIGHT_PER_THREAD = 4;
+const size_t MAX_PIXELS_IN_FLIGHT = size_t(1) << 23;
+
+// The largest image width or height, and sample count, a view may ask for.
+const long long MAX_IMAGE_SIZE = 1 << 16;
+const long long MAX_SAMPLES = 1 << 20;
+
+std::mutex consoleMutex;
+
+// Writes a finished view to its .ppm file and reports how long the batch has taken so far.
+void writeView(const BatchView& view, const FrameBuffer& frameBuffer,
+               std::chrono::steady_clock::time_point beginTime)
+{
+    std::ofstream imageFile;
+    imageFile.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    try {
+        imageFile.open(view.imagePath);
+        frameBuffer.writePPM(imageFile);
+        imageFile.close();
+    }
+    catch (std::ios_base::failure& e) {
+        std::lock_guard<std::mutex> lock(consoleMutex);
+        std::cerr << "Raytracer: " << view.imagePath << " " << e.what() << " error code: " << e.code() << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(consoleMutex);
+    std::cout << "Wrote " << view.imagePath << " after "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - beginTime).count()
+              << " seconds" << std::endl;
+}
+
+}
+
+/**
+ * Reads the views of a batch job, one per line:
+ *
+ *     width height samples  fromX fromY fromZ  atX atY atZ  vFov aperture focusDistance  imagePath  [upX upY upZ]
+ *
+ * The up vector is (0, 1, 0) unless given. Blank lines and lines starting with '#' are ignored.
+ * Throws std::runtime_error if a line can't be parsed, has anything after the up vector, has a
+ * width, height, or sample count that isn't a positive whole number (or is unreasonably large), or
+ * looks along its up vector.
+ */
+std::vector<BatchView> readBatchViews(std::istream& is)
+{
+    std::vector<BatchView> views;
+    std::string line;
+    uint lineNumber = 0;
+
+    while (std::getline(is, line)) {
+        lineNumber++;
+
+        std::istringstream lineStream(line);
+        std::string firstWord;
+        if (!(lineStream >> firstWord) || firstWord[0] == '#') {
+            continue;
+        }
+        lineStream.clear();
+        lineStream.seekg(0);
+
+        // The counts are read as signed numbers, so that a negative count is rejected rather than
+        // wrapped around to a huge one.
+        BatchView view;
+        long long width = 0;
+        long long height = 0;
+        long long nbrOfSamples = 0;
+        lineStream >> width >> height >> nbrOfSamples
+                   >> view.lookFrom >> view.lookAt
+                   >> view.vFov >> view.aperture >> view.focusDistance
+                   >> view.imagePath;
+        bool isValid = lineStream && width > 0 && width <= MAX_IMAGE_SIZE && height > 0 && height <= MAX_IMAGE_SIZE &&
+                       nbrOfSamples > 0 && nbrOfSamples <= MAX_SAMPLES;
+
+        // The up vector is optional, and nothing may follow it.
+        view.up = Vec3(0.0f, 1.0f, 0.0f);
+        if (isValid && !(lineStream >> std::ws).eof()) {
+            std::string extra;
+            isValid = lineStream >> view.up && !(lineStream >> extra);
+        }
+
+        // The camera can't tell which way is up when looking along the up vector.
+        Vec3 direction = view.lookAt - view.lookFrom;
+        if (isValid && Vec3::crossProduct(direction, view.up).length() <= 1e-6f * direction.length() * view.up.length()) {
+            throw std::runtime_error("batch job line " + std::to_string(lineNumber) +
+                                     " looks along its up vector (or nowhere); give it another up vector");
+        }
+        if (!isValid) {
+            throw std::runtime_error("batch job line " + std::to_string(lineNumber) + " is not a valid view");
+        }
+
+        view.imageWidth = uint(width);
+        view.imageHeight = uint(height);
+        view.nbrOfSamples = uint(nbrOfSamples);
+        views.push_back(view);
+    }
+
+    return views;
+}
+
+/**
+ * Renders every view of the world. All views' tiles are queued on the same thread pool, in view
+ * order, so the pool stays busy across view boundaries; each view's image is written (and its
+ * frame buffer freed) by whichever thread finishes its last tile. Views are queued as long as there
+ * are too few tiles queued to keep every thread busy and the pixels of the unfinished views stay
+ * within a bound. Returns once every image has been written.
+ * @param worlds One copy of the world per NUMA node of the pool (see buildNodeLocalWorlds()).
+ */
+void renderBatch(const std::vector<BatchView>& views,
+                 const std::vector<std::shared_ptr<const HitableCollection>>& worlds, ThreadPool& pool)
+{
+    auto beginTime = std::chrono::steady_clock::now();
+
+    // A view is queued once few enough tiles are queued or rendering, which keeps the next views'
+    // tiles queued up behind the current ones however small the views are, and once its pixels fit
+    // within the bound on the frame buffers alive at once.
+    const size_t maxTilesInFlight = size_t(TILES_IN_FLIGHT_PER_THREAD) * pool.size();
+    std::mutex viewsMutex;
+    std::condition_variable workFinished;
+    size_t nbrOfTilesInFlight = 0;
+    size_t nbrOfPixelsInFlight = 0;
+
+    std::vector<std::unique_ptr<ViewJob>> jobs;
+    for (const auto& view : views) {
+        std::vector<Tile> tiles = splitIntoTiles(view.imageWidth, view.imageHeight);
+        const size_t nbrOfPixels = size_t(view.imageWidth) * view.imageHeight;
+        {
+            std::unique_lock<std::mutex> lock(viewsMutex);
+            workFinished.wait(lock, [&] {
+                return nbrOfPixelsInFlight == 0 ||
+                       (nbrOfTilesInFlight < maxTilesInFlight && nbrOfPixelsInFlight + nbrOfPixels <= MAX_PIXELS_IN_FLIGHT);
+            });
+            nbrOfTilesInFlight += tiles.size();
+            nbrOfPixelsInFlight += nbrOfPixels;
+        }
+
+        jobs.emplace_back(new ViewJob(view));
+        ViewJob* job = jobs.back().get();
+        job->nbrOfRemainingTiles = uint(tiles.size());
+
+        for (size_t t = 0; t < tiles.size(); ++t) {
+            const Tile& tile = tiles[t];
+            pool.submit([&, job, tile, nbrOfPixels] {
+                // Clearing the tile first touches its part of the frame buffer from this node.
+                const HitableCollection* world = worlds[ThreadPool::currentNode()].get();
+                job->frameBuffer->clear(tile.startI, tile.startJ, tile.endI, tile.endJ);
+                renderTile(job->camera, world, *job->frameBuffer, tile, view.nbrOfSamples);
+
+                bool isViewDone = (--job->nbrOfRemainingTiles == 0);
+                if (isViewDone) {
+                    writeView(view, *job->frameBuffer, beginTime);
+                    job->frameBuffer.reset();
+                }
+
+                std::lock_guard<std::mutex> lock(viewsMutex);
+                nbrOfTilesInFlight--;
+                if (isViewDone) {
+                    nbrOfPixelsInFlight -= nbrOfPixels;
+                }
+                workFinished.notify_one();
+            }, nodeForTile(t, tiles.size(), pool.topology().nbrOfNodes()));
+        }
+    }
+
+    pool.wait();
+}
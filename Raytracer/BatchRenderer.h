@@ -0,0 +1,51 @@
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "HitableCollection.h"
+#include "ThreadPool.h"
+#include "Vec3.h"
+
+/**
+ * One view of a batch job: where the camera is, the image resolution and sample count, and the
+ * .ppm file the image is written to.
+ */
+struct BatchView
+{
+    Vec3 lookFrom;
+    Vec3 lookAt;
+    Vec3 up;
+    float vFov;
+    float aperture;
+    float focusDistance;
+    uint imageWidth;
+    uint imageHeight;
+    uint nbrOfSamples;
+    std::string imagePath;
+};
+
+/**
+ * Reads the views of a batch job, one per line:
+ *
+ *     width height samples  fromX fromY fromZ  atX atY atZ  vFov aperture focusDistance  imagePath  [upX upY upZ]
+ *
+ * The up vector is (0, 1, 0) unless given. Blank lines and lines starting with '#' are ignored.
+ * Throws std::runtime_error if a line can't be parsed, has anything after the up vector, has a
+ * width, height, or sample count that isn't a positive whole number (or is unreasonably large), or
+ * looks along its up vector.
+ */
+std::vector<BatchView> readBatchViews(std::istream& is);
+
+/**
+ * Renders every view of the world. All views' tiles are queued on the same thread pool, in view
+ * order, so the pool stays busy across view boundaries; each view's image is written (and its
+ * frame buffer freed) by whichever thread finishes its last tile. Views are queued as long as there
+ * are too few tiles queued to keep every thread busy and the pixels of the unfinished views stay
+ * within a bound. Returns once every image has been written.
+ * @param worlds One copy of the world per NUMA node of the pool (see buildNodeLocalWorlds()).
+ */
+void renderBatch(const std::vector<BatchView>& views,
+                 const std::vector<std::shared_ptr<const HitableCollection>>& worlds, ThreadPool& pool);
@@ -1,7 +1,10 @@
 #include "Camera.h"
 
+#include <algorithm>
 #include <cmath>
 
+#include "Random.h"
+
 /**
  * Creates a new camera.
  * @param lookFrom Camera position.
@@ -33,20 +36,95 @@ Camera::Camera(const Vec3& lookFrom, const Vec3& lookAt, const Vec3& up,
 }
 
 /** Calculates a ray for the supplied position. */
-Ray Camera::calculateRay(float s, float t)
+Ray Camera::calculateRay(float s, float t) const
 {
     Vec3 randomPointOnLens = lensRadius * randomPointInUnitDisk();
     Vec3 offset = u * randomPointOnLens.x() + v * randomPointOnLens.y();
     return Ray(origin + offset, lowerLeftCorner + s * horizontal + t * vertical - origin - offset);
 }
 
+/**
+ * Returns the direction from the lens center to the supplied position on the focus plane. The
+ * direction is linear in s and t, so it can be stepped from pixel to pixel.
+ */
+Vec3 Camera::directionTo(float s, float t) const
+{
+    return lowerLeftCorner + s * horizontal + t * vertical - origin;
+}
+
+/**
+ * Returns the offset from the lens center of the lens point that maps to (a, b) in the unit
+ * square. Uses the concentric mapping, so stratified (a, b) give stratified lens points.
+ */
+Vec3 Camera::lensOffset(float a, float b) const
+{
+    // Shirley and Chiu, "A Low Distortion Map Between Disk and Square".
+    float x = 2.0f * a - 1.0f;
+    float y = 2.0f * b - 1.0f;
+    if (x == 0.0f && y == 0.0f) {
+        return Vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    float r;
+    float phi;
+    if (fabs(x) > fabs(y)) {
+        r = x;
+        phi = float(M_PI / 4) * (y / x);
+    }
+    else {
+        r = y;
+        phi = float(M_PI / 2) - float(M_PI / 4) * (x / y);
+    }
+
+    return lensRadius * r * (u * cosf(phi) + v * sinf(phi));
+}
+
+/**
+ * Returns false only if no ray calculated for a position within [s0, s1] x [t0, t1] can hit the
+ * supplied sphere. (It may return true for spheres that can't actually be hit.)
+ */
+bool Camera::couldSee(const Vec3& center, float radius, float s0, float t0, float s1, float t1) const
+{
+    // Work in camera space: x along u, y along v, and depth in front of the lens (along -w).
+    Vec3 offset = center - origin;
+    float x = Vec3::dotProduct(offset, u);
+    float y = Vec3::dotProduct(offset, v);
+    float depth = -Vec3::dotProduct(offset, w);
+    if (depth + radius < 0.0f) {
+        return false;   // behind the lens
+    }
+
+    // The rectangle on the focus plane that the rays pass through.
+    Vec3 corner = lowerLeftCorner - origin;
+    float focusDistance = -Vec3::dotProduct(corner, w);
+    float x0 = Vec3::dotProduct(corner + s0 * horizontal, u);
+    float x1 = Vec3::dotProduct(corner + s1 * horizontal, u);
+    float y0 = Vec3::dotProduct(corner + t0 * vertical, v);
+    float y1 = Vec3::dotProduct(corner + t1 * vertical, v);
+
+    // A ray from lens point L through focus plane point F is at L + (depth / focusDistance)(F - L)
+    // at any depth, so the bundle's cross section there is the rectangle scaled by
+    // depth / focusDistance, grown by the lens radius scaled by |1 - depth / focusDistance|.
+    float scale = depth / focusDistance;
+    float grow = fabs(1.0f - scale) * lensRadius;
+
+    // The sphere spans depths depth +/- radius, over which the cross section's edges move at most
+    // this much per unit of depth.
+    float slope = (std::max(std::max(fabs(x0), fabs(x1)), std::max(fabs(y0), fabs(y1))) + lensRadius) / focusDistance;
+    float margin = radius * (1.0f + slope);
+
+    float dx = std::max(std::max(std::min(x0, x1) * scale - grow - x, x - std::max(x0, x1) * scale - grow), 0.0f);
+    float dy = std::max(std::max(std::min(y0, y1) * scale - grow - y, y - std::max(y0, y1) * scale - grow), 0.0f);
+    return dx <= margin && dy <= margin;
+}
+
 /** Simulates the camera's the lens. This allows the camera to support depth of field. */
-Vec3 Camera::randomPointInUnitDisk()
+Vec3 Camera::randomPointInUnitDisk() const
 {
     Vec3 point;
 
     do {
-        point = 2 * Vec3(drand48(), drand48(), 0.0f) - Vec3(1.0f, 1.0f, 0.0f);
+        point = 2 * Vec3(randomFloat(), randomFloat(), 0.0f) - Vec3(1.0f, 1.0f, 0.0f);
     }
     while (Vec3::dotProduct(point, point) >= 1);
 
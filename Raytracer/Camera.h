@@ -20,7 +20,28 @@ public:
            float vFov, float aspectRatio, float aperture, float focusDistance);
 
     /** Calculates a ray for the supplied position. */
-    Ray calculateRay(float s, float t);
+    Ray calculateRay(float s, float t) const;
+
+    /** Returns the center of the lens; rays start at the lens center plus a lens offset. */
+    Vec3 lensCenter() const { return origin; }
+
+    /**
+     * Returns the direction from the lens center to the supplied position on the focus plane. The
+     * direction is linear in s and t, so it can be stepped from pixel to pixel.
+     */
+    Vec3 directionTo(float s, float t) const;
+
+    /**
+     * Returns the offset from the lens center of the lens point that maps to (a, b) in the unit
+     * square. Uses the concentric mapping, so stratified (a, b) give stratified lens points.
+     */
+    Vec3 lensOffset(float a, float b) const;
+
+    /**
+     * Returns false only if no ray calculated for a position within [s0, s1] x [t0, t1] can hit the
+     * supplied sphere. (It may return true for spheres that can't actually be hit.)
+     */
+    bool couldSee(const Vec3& center, float radius, float s0, float t0, float s1, float t1) const;
 
 private:
     Vec3 origin;
@@ -32,5 +53,5 @@ private:
     float lensRadius;
 
     /** Simulates the camera's the lens. This allows the camera to support depth of field. */
-    Vec3 randomPointInUnitDisk();
+    Vec3 randomPointInUnitDisk() const;
 };
@@ -0,0 +1,238 @@
+#include "ChunkedScene.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+// Chunks are stored as raw arrays of SphereDescription, and the index as a header followed by a raw
+// array of ChunkInfo.
+static_assert(std::is_trivially_copyable<SphereDescription>::value, "spheres are written as raw bytes");
+static_assert(std::is_trivially_copyable<ChunkInfo>::value, "chunk infos are written as raw bytes");
+
+const char INDEX_MAGIC[8] = {'R', 'T', 'C', 'H', 'U', 'N', 'K', 'S'};
+const uint32_t INDEX_VERSION = 1;
+
+// Returns the path of the index file in a chunked scene directory.
+static std::string indexPath(const std::string& directory)
+{
+    return directory + "/index.bin";
+}
+
+// Returns the path of a chunk file in a chunked scene directory.
+static std::string chunkPath(const std::string& directory, uint id)
+{
+    return directory + "/chunk" + std::to_string(id) + ".bin";
+}
+
+/** Creates a new ChunkedSceneWriter for an existing (and preferably empty) directory. */
+ChunkedSceneWriter::ChunkedSceneWriter(const std::string& directory)
+        : _directory(directory)
+{ }
+
+/**
+ * Writes the spheres out right away as the next chunk and adds it to the index. Throws
+ * std::runtime_error if the chunk can't be written.
+ */
+void ChunkedSceneWriter::writeChunk(const Chunk& spheres)
+{
+    ChunkInfo info{uint(_chunks.size()), uint(spheres.size()), spheres[0].center, spheres[0].center};
+    for (const SphereDescription& sphere : spheres) {
+        Vec3 extent(sphere.radius, sphere.radius, sphere.radius);
+        Vec3 sphereMin = sphere.center - extent;
+        Vec3 sphereMax = sphere.center + extent;
+        info.boundsMin = Vec3(std::min(info.boundsMin.x(), sphereMin.x()),
+                              std::min(info.boundsMin.y(), sphereMin.y()),
+                              std::min(info.boundsMin.z(), sphereMin.z()));
+        info.boundsMax = Vec3(std::max(info.boundsMax.x(), sphereMax.x()),
+                              std::max(info.boundsMax.y(), sphereMax.y()),
+                              std::max(info.boundsMax.z(), sphereMax.z()));
+    }
+
+    std::ofstream file(chunkPath(_directory, info.id), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(spheres.data()), spheres.size() * sizeof(SphereDescription));
+    file.close();
+    if (!file) {
+        throw std::runtime_error("can't write chunk " + std::to_string(info.id));
+    }
+
+    _chunks.push_back(info);
+}
+
+/**
+ * Writes the index. The scene can't be read until this has been called. Throws
+ * std::runtime_error if the index can't be written.
+ */
+void ChunkedSceneWriter::finish()
+{
+    std::ofstream index(indexPath(_directory), std::ios::binary);
+    uint32_t nbrOfChunks = uint32_t(_chunks.size());
+    index.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    index.write(reinterpret_cast<const char*>(&INDEX_VERSION), sizeof(INDEX_VERSION));
+    index.write(reinterpret_cast<const char*>(&nbrOfChunks), sizeof(nbrOfChunks));
+    index.write(reinterpret_cast<const char*>(_chunks.data()), _chunks.size() * sizeof(ChunkInfo));
+    index.close();
+    if (!index) {
+        throw std::runtime_error("can't write the chunked scene index");
+    }
+}
+
+/**
+ * Opens the chunked scene in a directory, reading its index.
+ * @param memoryBudget The most bytes of chunk data to keep in memory. A chunk bigger than the
+ * budget is still paged in, but is evicted as soon as the next chunk is needed.
+ * Throws std::runtime_error if the index can't be read.
+ */
+ChunkCache::ChunkCache(const std::string& directory, size_t memoryBudget)
+        : _directory(directory),
+          _memoryBudget(memoryBudget),
+          _residentBytes(0),
+          _statistics{0, 0, 0, 0, 0}
+{
+    std::ifstream index(indexPath(directory), std::ios::binary);
+    char magic[sizeof(INDEX_MAGIC)];
+    uint32_t version = 0;
+    uint32_t nbrOfChunks = 0;
+    index.read(magic, sizeof(magic));
+    index.read(reinterpret_cast<char*>(&version), sizeof(version));
+    index.read(reinterpret_cast<char*>(&nbrOfChunks), sizeof(nbrOfChunks));
+    if (!index || memcmp(magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || version != INDEX_VERSION) {
+        throw std::runtime_error("isn't a chunked scene (can't read its index)");
+    }
+
+    _chunks.resize(nbrOfChunks);
+    index.read(reinterpret_cast<char*>(_chunks.data()), _chunks.size() * sizeof(ChunkInfo));
+    if (!index) {
+        throw std::runtime_error("has a truncated chunked scene index");
+    }
+}
+
+/** Returns true if the chunk is in memory, i.e., load() wouldn't have to go to disk. */
+bool ChunkCache::isResident(uint id) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _resident.count(id) > 0;
+}
+
+/**
+ * Returns the chunk's spheres, reading them from disk if they aren't in memory and evicting the
+ * least recently used chunks to make room. Throws std::runtime_error if the chunk can't be read.
+ */
+std::shared_ptr<const Chunk> ChunkCache::load(uint id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _statistics.nbrOfRequests++;
+
+    auto found = _resident.find(id);
+    if (found != _resident.end()) {
+        _recentlyUsed.splice(_recentlyUsed.begin(), _recentlyUsed, found->second.second);
+        return found->second.first;
+    }
+
+    const ChunkInfo& info = _chunks.at(id);
+    size_t bytes = size_t(info.nbrOfSpheres) * sizeof(SphereDescription);
+
+    // Make room first, so the budget holds even while the chunk is being read.
+    while (!_recentlyUsed.empty() && _residentBytes + bytes > _memoryBudget) {
+        uint evicted = _recentlyUsed.back();
+        _residentBytes -= _resident[evicted].first->size() * sizeof(SphereDescription);
+        _resident.erase(evicted);
+        _recentlyUsed.pop_back();
+        _statistics.nbrOfEvictions++;
+    }
+
+    auto chunk = std::make_shared<Chunk>(info.nbrOfSpheres);
+    std::ifstream file(chunkPath(_directory, id), std::ios::binary);
+    file.read(reinterpret_cast<char*>(chunk->data()), bytes);
+    if (!file) {
+        throw std::runtime_error("can't read chunk " + std::to_string(id));
+    }
+
+    _recentlyUsed.push_front(id);
+    _resident[id] = std::make_pair(chunk, _recentlyUsed.begin());
+    _residentBytes += bytes;
+
+    _statistics.nbrOfPageIns++;
+    _statistics.bytesPagedIn += bytes;
+    _statistics.peakResidentBytes = std::max(_statistics.peakResidentBytes, _residentBytes);
+
+    return chunk;
+}
+
+ChunkCacheStatistics ChunkCache::statistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _statistics;
+}
+
+// Writes the spheres [begin, end) of the supplied order as chunks of at most spheresPerChunk spheres
+// each; see writeChunkedScene().
+static void writeSplitChunks(const std::vector<SphereDescription>& spheres, std::vector<uint>::iterator begin,
+                             std::vector<uint>::iterator end, uint spheresPerChunk, ChunkedSceneWriter& writer)
+{
+    if (size_t(end - begin) <= spheresPerChunk) {
+        Chunk chunk;
+        chunk.reserve(size_t(end - begin));
+        for (auto s = begin; s != end; ++s) {
+            chunk.push_back(spheres[*s]);
+        }
+        writer.writeChunk(chunk);
+        return;
+    }
+
+    Vec3 centersMin = spheres[*begin].center;
+    Vec3 centersMax = centersMin;
+    for (auto s = begin; s != end; ++s) {
+        const Vec3& center = spheres[*s].center;
+        centersMin = Vec3(std::min(centersMin.x(), center.x()), std::min(centersMin.y(), center.y()),
+                          std::min(centersMin.z(), center.z()));
+        centersMax = Vec3(std::max(centersMax.x(), center.x()), std::max(centersMax.y(), center.y()),
+                          std::max(centersMax.z(), center.z()));
+    }
+    Vec3 extent = centersMax - centersMin;
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) {
+        if (extent[a] > extent[axis]) {
+            axis = a;
+        }
+    }
+
+    // Split off the spheres wider than the part itself, unless that's all of them.
+    auto firstBig = std::partition(begin, end, [&](uint s) { return 2.0f * spheres[s].radius <= extent[axis]; });
+    if (firstBig != begin && firstBig != end) {
+        writeSplitChunks(spheres, begin, firstBig, spheresPerChunk, writer);
+        writeSplitChunks(spheres, firstBig, end, spheresPerChunk, writer);
+        return;
+    }
+
+    auto middle = begin + (end - begin) / 2;
+    std::nth_element(begin, middle, end, [&](uint a, uint b) {
+        return spheres[a].center[axis] < spheres[b].center[axis];
+    });
+    writeSplitChunks(spheres, begin, middle, spheresPerChunk, writer);
+    writeSplitChunks(spheres, middle, end, spheresPerChunk, writer);
+}
+
+/**
+ * Writes the spheres out as a chunked scene in the directory, with chunks sized to the scene: the
+ * spheres are split in two at the median of their centers along the longest axis, again and again,
+ * until each part holds at most spheresPerChunk spheres. Spheres bigger than the part they are in
+ * (such as a ground sphere) are split off first, so their bounding boxes don't make every ray visit
+ * the small spheres around them. The spheres are split in memory, so the whole scene has to fit in
+ * memory while it is written; only rendering the scene works within a memory budget. Throws
+ * std::runtime_error if a file can't be written.
+ */
+void writeChunkedScene(const std::vector<SphereDescription>& spheres, const std::string& directory,
+                       uint spheresPerChunk)
+{
+    ChunkedSceneWriter writer(directory);
+    if (!spheres.empty()) {
+        std::vector<uint> order(spheres.size());
+        for (uint s = 0; s < order.size(); ++s) {
+            order[s] = s;
+        }
+        writeSplitChunks(spheres, order.begin(), order.end(), std::max(spheresPerChunk, 1u), writer);
+    }
+    writer.finish();
+}
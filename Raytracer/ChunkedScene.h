@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SceneDescription.h"
+#include "Vec3.h"
+
+/**
+ * Scenes too big to render from memory are stored on disk in chunks: each chunk file holds the
+ * spheres of one small region of space, and an index file lists every chunk with its bounding box.
+ * Renders only page in the chunks their rays can hit. Writing a chunked scene (writeChunkedScene())
+ * still needs the whole scene in memory; it is rendering that works within a memory budget.
+ *
+ * Files are written in the machine's native byte order and are not meant to be moved between
+ * machines.
+ */
+
+/** A chunk's entry in the index. */
+struct ChunkInfo
+{
+    uint id;
+    uint nbrOfSpheres;
+    Vec3 boundsMin;     // bounding box of the chunk's spheres
+    Vec3 boundsMax;
+};
+
+/** The spheres of one chunk, as paged in from disk. */
+typedef std::vector<SphereDescription> Chunk;
+
+/** Page-in counts for a ChunkCache. */
+struct ChunkCacheStatistics
+{
+    unsigned long long nbrOfRequests;       // chunks asked for
+    unsigned long long nbrOfPageIns;        // chunks read from disk (cache misses)
+    unsigned long long nbrOfEvictions;      // chunks dropped to stay within the memory budget
+    unsigned long long bytesPagedIn;
+    size_t peakResidentBytes;
+
+    /** Returns the fraction of requests that were served without going to disk. */
+    double hitRate() const { return nbrOfRequests > 0 ? 1.0 - double(nbrOfPageIns) / nbrOfRequests : 0.0; }
+};
+
+/**
+ * Writes a chunked scene, one chunk at a time, from spheres the caller has already grouped into
+ * chunks (see writeChunkedScene()).
+ */
+class ChunkedSceneWriter final
+{
+public:
+    /** Creates a new ChunkedSceneWriter for an existing (and preferably empty) directory. */
+    explicit ChunkedSceneWriter(const std::string& directory);
+
+    ChunkedSceneWriter(const ChunkedSceneWriter& rhs) = delete;
+    ChunkedSceneWriter(ChunkedSceneWriter&& rhs) = delete;
+    ChunkedSceneWriter& operator=(const ChunkedSceneWriter& rhs) = delete;
+    ChunkedSceneWriter& operator=(ChunkedSceneWriter&& rhs) = delete;
+
+    /**
+     * Writes the spheres out right away as the next chunk and adds it to the index. Throws
+     * std::runtime_error if the chunk can't be written.
+     */
+    void writeChunk(const Chunk& spheres);
+
+    /**
+     * Writes the index. The scene can't be read until this has been called. Throws
+     * std::runtime_error if the index can't be written.
+     */
+    void finish();
+
+private:
+    std::string _directory;
+    std::vector<ChunkInfo> _chunks;
+};
+
+/**
+ * Pages the chunks of a chunked scene in from disk on demand, keeping the most recently used
+ * chunks in memory for as long as they fit within a memory budget.
+ *
+ * Thread safe.
+ */
+class ChunkCache final
+{
+public:
+    /**
+     * Opens the chunked scene in a directory, reading its index.
+     * @param memoryBudget The most bytes of chunk data to keep in memory. A chunk bigger than the
+     * budget is still paged in, but is evicted as soon as the next chunk is needed.
+     * Throws std::runtime_error if the index can't be read.
+     */
+    ChunkCache(const std::string& directory, size_t memoryBudget);
+
+    ChunkCache(const ChunkCache& rhs) = delete;
+    ChunkCache(ChunkCache&& rhs) = delete;
+    ChunkCache& operator=(const ChunkCache& rhs) = delete;
+    ChunkCache& operator=(ChunkCache&& rhs) = delete;
+
+    /** Returns the index: every chunk in the scene, indexed by chunk id. */
+    const std::vector<ChunkInfo>& chunks() const { return _chunks; }
+
+    /** Returns true if the chunk is in memory, i.e., load() wouldn't have to go to disk. */
+    bool isResident(uint id) const;
+
+    /**
+     * Returns the chunk's spheres, reading them from disk if they aren't in memory and evicting the
+     * least recently used chunks to make room. Throws std::runtime_error if the chunk can't be read.
+     */
+    std::shared_ptr<const Chunk> load(uint id);
+
+    ChunkCacheStatistics statistics() const;
+
+private:
+    std::string _directory;
+    size_t _memoryBudget;
+    std::vector<ChunkInfo> _chunks;
+
+    mutable std::mutex _mutex;
+    std::list<uint> _recentlyUsed;      // resident chunk ids, most recently used first
+    std::unordered_map<uint, std::pair<std::shared_ptr<const Chunk>, std::list<uint>::iterator>> _resident;
+    size_t _residentBytes;
+    ChunkCacheStatistics _statistics;
+};
+
+/**
+ * Writes the spheres out as a chunked scene in the directory, with chunks sized to the scene: the
+ * spheres are split in two at the median of their centers along the longest axis, again and again,
+ * until each part holds at most spheresPerChunk spheres. Spheres bigger than the part they are in
+ * (such as a ground sphere) are split off first, so their bounding boxes don't make every ray visit
+ * the small spheres around them. The spheres are split in memory, so the whole scene has to fit in
+ * memory while it is written; only rendering the scene works within a memory budget. Throws
+ * std::runtime_error if a file can't be written.
+ */
+void writeChunkedScene(const std::vector<SphereDescription>& spheres, const std::string& directory,
+                       uint spheresPerChunk);
@@ -0,0 +1,99 @@
+#include "FrameBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "PPMEncoding.h"
+
+/**
+ * Creates a new FrameBuffer with no samples taken for any of its pixels.
+ * @param isCleared If false, the pixels are left uninitialized (and their memory untouched)
+ * until clear() is called for them. A render thread that clears the block it renders is the
+ * first to touch its memory, so on NUMA machines the block is placed on that thread's node.
+ */
+FrameBuffer::FrameBuffer(uint width, uint height, bool isCleared)
+        : _width(width),
+          _height(height),
+          _pixels(new Pixel[size_t(width) * height])     // default initialized, i.e., not written
+{
+    if (isCleared) {
+        clear(0, 0, width, height);
+    }
+}
+
+/** Resets the pixels of the block [startI, endI) x [startJ, endJ) to having no samples. */
+void FrameBuffer::clear(uint startI, uint startJ, uint endI, uint endJ)
+{
+    for (uint j = startJ; j < endJ; ++j) {
+        std::fill(&pixel(startI, j), &pixel(startI, j) + (endI - startI),
+                  Pixel{Vec3(0.0f, 0.0f, 0.0f), 0.0f, 0.0f, 0});
+    }
+}
+
+/** Adds a color sample to the supplied pixel. */
+void FrameBuffer::addSample(uint i, uint j, const Vec3& color)
+{
+    // Rec. 709 luma weights.
+    float luminance = 0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2];
+
+    Pixel& p = pixel(i, j);
+    p.colorSum += color;
+    p.luminanceSum += luminance;
+    p.squaredLuminanceSum += luminance * luminance;
+    p.sampleCount++;
+}
+
+/** Returns the average of the samples taken for the supplied pixel (black if there are none). */
+Vec3 FrameBuffer::averageColor(uint i, uint j) const
+{
+    const Pixel& p = pixel(i, j);
+    if (p.sampleCount == 0) {
+        return Vec3(0.0f, 0.0f, 0.0f);
+    }
+    return p.colorSum / float(p.sampleCount);
+}
+
+/**
+ * Returns the standard error of the supplied pixel's mean luminance, i.e., how far off its
+ * average color is likely to be. Pixels with fewer than two samples return infinity.
+ */
+float FrameBuffer::standardError(uint i, uint j) const
+{
+    const Pixel& p = pixel(i, j);
+    if (p.sampleCount < 2) {
+        return std::numeric_limits<float>::infinity();
+    }
+
+    float n = float(p.sampleCount);
+    float mean = p.luminanceSum / n;
+    float variance = (p.squaredLuminanceSum - n * mean * mean) / (n - 1.0f);
+    if (variance < 0.0f) {  // rounding error
+        variance = 0.0f;
+    }
+    return sqrtf(variance / n);
+}
+
+/** Writes the averaged, gamma corrected image to the supplied stream as a .ppm file. */
+void FrameBuffer::writePPM(std::ostream& os) const
+{
+    os << "P3\n" << _width << " " << _height << "\n255\n";
+
+    std::vector<float> rowPixels(3 * _width);
+    std::string text;
+
+    for (int j = _height - 1; j >= 0; --j) {
+        for (uint i = 0; i < _width; ++i) {
+            Vec3 color = averageColor(i, j);
+            rowPixels[3 * i] = color[0];
+            rowPixels[3 * i + 1] = color[1];
+            rowPixels[3 * i + 2] = color[2];
+        }
+
+        text.clear();
+        encodePPMRow(rowPixels.data(), _width, text);
+        os.write(text.data(), text.size());
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+
+#include "Vec3.h"
+
+/**
+ * Accumulates the color samples taken for each pixel of an image so that pixels can be sampled
+ * any number of times, in any order, before the image is finalized. Pixel (0, 0) is the lower left
+ * corner of the image, matching the camera's (s, t) coordinates.
+ */
+class FrameBuffer final
+{
+public:
+    /**
+     * Creates a new FrameBuffer with no samples taken for any of its pixels.
+     * @param isCleared If false, the pixels are left uninitialized (and their memory untouched)
+     * until clear() is called for them. A render thread that clears the block it renders is the
+     * first to touch its memory, so on NUMA machines the block is placed on that thread's node.
+     */
+    FrameBuffer(uint width, uint height, bool isCleared = true);
+
+    FrameBuffer(const FrameBuffer& rhs) = delete;
+    FrameBuffer(FrameBuffer&& rhs) = delete;
+    FrameBuffer& operator=(const FrameBuffer& rhs) = delete;
+    FrameBuffer& operator=(FrameBuffer&& rhs) = delete;
+
+    uint width() const  { return _width; }
+
+    uint height() const { return _height; }
+
+    /** Resets the pixels of the block [startI, endI) x [startJ, endJ) to having no samples. */
+    void clear(uint startI, uint startJ, uint endI, uint endJ);
+
+    /** Adds a color sample to the supplied pixel. */
+    void addSample(uint i, uint j, const Vec3& color);
+
+    /** Returns the number of samples taken for the supplied pixel. */
+    uint sampleCount(uint i, uint j) const { return pixel(i, j).sampleCount; }
+
+    /** Returns the average of the samples taken for the supplied pixel (black if there are none). */
+    Vec3 averageColor(uint i, uint j) const;
+
+    /**
+     * Returns the standard error of the supplied pixel's mean luminance, i.e., how far off its
+     * average color is likely to be. Pixels with fewer than two samples return infinity.
+     */
+    float standardError(uint i, uint j) const;
+
+    /** Writes the averaged, gamma corrected image to the supplied stream as a .ppm file. */
+    void writePPM(std::ostream& os) const;
+
+private:
+    struct Pixel
+    {
+        Vec3 colorSum;
+        float luminanceSum;
+        float squaredLuminanceSum;
+        uint sampleCount;
+    };
+
+    uint _width;
+    uint _height;
+    std::unique_ptr<Pixel[]> _pixels;
+
+    const Pixel& pixel(uint i, uint j) const { return _pixels[j * _width + i]; }
+
+    Pixel& pixel(uint i, uint j) { return _pixels[j * _width + i]; }
+};
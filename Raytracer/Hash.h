@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Mixes a value into a running hash. Uses the SplitMix64 finalizer, so nearby inputs (e.g., tile
+ * coordinates) give unrelated outputs.
+ */
+inline uint64_t hashCombine(uint64_t hash, uint64_t value)
+{
+    uint64_t x = hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/** Mixes a float into a running hash, by its bits. */
+inline uint64_t hashCombine(uint64_t hash, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return hashCombine(hash, uint64_t(bits));
+}
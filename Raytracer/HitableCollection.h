@@ -27,6 +27,9 @@ public:
     /** Returns true if the ray hits this object. */
     bool hit(const Ray& r, float t_min, float t_max, HitableProperties& properties) const;
 
+    /** Returns the objects in this collection. */
+    const std::vector<HitableObject*>& objects() const { return _list; }
+
 private:
     std::vector<HitableObject*> _list;
 };
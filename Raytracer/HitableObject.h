@@ -22,4 +22,7 @@ public:
     virtual ~HitableObject() { }
 
     virtual bool hit(const Ray& r, float t_min, float t_max, HitableProperties& properties) const = 0;
+
+    /** Sets center and radius to a sphere that encloses this object. */
+    virtual void boundingSphere(Vec3& center, float& radius) const = 0;
 };
@@ -0,0 +1,132 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+
+#include "PPMEncoding.h"
+
+/**
+ * Creates a new ImageWriter and starts its thread, which writes the .ppm header right away.
+ * @param maxRowsInFlight The maximum number of rows being rendered or waiting to be written.
+ */
+ImageWriter::ImageWriter(std::ostream& os, uint width, uint height, uint maxRowsInFlight)
+        : _os(os),
+          _width(width),
+          _height(height),
+          _maxRowsInFlight(std::max(1u, maxRowsInFlight)),
+          _nbrOfRowsWritten(0),
+          _isAborted(false),
+          _thread(&ImageWriter::writeRows, this)
+{ }
+
+/**
+ * Stops the writer thread; call finish() first to write every row and find out if writing
+ * failed. Otherwise (e.g., when rendering was cut short by an exception) the writer is aborted,
+ * so the destructor never waits for rows that will not be submitted.
+ */
+ImageWriter::~ImageWriter()
+{
+    if (_thread.joinable()) {
+        abort();
+        _thread.join();
+    }
+}
+
+/**
+ * Blocks until the supplied row (0 is the top row) may be rendered, then returns a buffer for
+ * it: width pixels, each three floats (red, green, blue).
+ */
+std::vector<float> ImageWriter::acquireRow(uint row)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _rowWritten.wait(lock, [&] { return _isAborted || row < _nbrOfRowsWritten + _maxRowsInFlight; });
+
+    if (_freeRows.empty()) {
+        return std::vector<float>(3 * _width);
+    }
+    std::vector<float> pixels = std::move(_freeRows.back());
+    _freeRows.pop_back();
+    return pixels;
+}
+
+/** Hands a rendered row (linear color, as returned by acquireRow()) over to be written. */
+void ImageWriter::submitRow(uint row, std::vector<float>&& pixels)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _submittedRows[row] = std::move(pixels);
+    }
+    _rowSubmitted.notify_one();
+}
+
+/**
+ * Waits until every row has been written. Rethrows the error (std::ios_base::failure) if the
+ * stream failed.
+ */
+void ImageWriter::finish()
+{
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_error) {
+        std::rethrow_exception(_error);
+    }
+}
+
+/**
+ * Stops writing without waiting for the rows still missing: the writer thread stops after the
+ * row it is writing, rows not yet written are dropped, and acquireRow() no longer blocks.
+ */
+void ImageWriter::abort()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isAborted = true;
+    }
+    _rowSubmitted.notify_one();
+    _rowWritten.notify_all();
+}
+
+// Writer thread loop: writes the header, then each row as soon as it and every row above it have
+// been submitted, until every row is written or the writer is aborted. After a write error, rows are
+// still taken (and dropped) so that render threads never block for good.
+void ImageWriter::writeRows()
+{
+    std::string text;
+    auto writeText = [&] {
+        if (!_error) {
+            try {
+                _os.write(text.data(), text.size());
+            }
+            catch (std::ios_base::failure&) {
+                _error = std::current_exception();
+            }
+        }
+        text.clear();
+    };
+
+    text = "P3\n" + std::to_string(_width) + " " + std::to_string(_height) + "\n255\n";
+    writeText();
+
+    for (uint row = 0; row < _height; ++row) {
+        std::vector<float> pixels;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _rowSubmitted.wait(lock, [&] { return _isAborted || _submittedRows.count(row) > 0; });
+            if (_isAborted) {
+                return;
+            }
+            pixels = std::move(_submittedRows[row]);
+            _submittedRows.erase(row);
+        }
+
+        encodePPMRow(pixels.data(), _width, text);
+        writeText();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _freeRows.push_back(std::move(pixels));
+            _nbrOfRowsWritten++;
+        }
+        _rowWritten.notify_all();
+    }
+}
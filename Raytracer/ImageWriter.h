@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Writes an image to a .ppm file on its own thread, so render threads never wait on formatting or
+ * disk I/O. Render threads hand over finished rows of linear color; the writer thread gamma
+ * corrects and encodes them, and writes them in order, top row first.
+ *
+ * Only a bounded number of rows are held at once, so an image of any size streams to disk in
+ * bounded memory: acquireRow() blocks while the row is too far ahead of the last row written.
+ */
+class ImageWriter final
+{
+public:
+    /**
+     * Creates a new ImageWriter and starts its thread, which writes the .ppm header right away.
+     * @param maxRowsInFlight The maximum number of rows being rendered or waiting to be written.
+     */
+    ImageWriter(std::ostream& os, uint width, uint height, uint maxRowsInFlight);
+
+    ImageWriter(const ImageWriter& rhs) = delete;
+    ImageWriter(ImageWriter&& rhs) = delete;
+    ImageWriter& operator=(const ImageWriter& rhs) = delete;
+    ImageWriter& operator=(ImageWriter&& rhs) = delete;
+
+    /**
+     * Stops the writer thread; call finish() first to write every row and find out if writing
+     * failed. Otherwise (e.g., when rendering was cut short by an exception) the writer is aborted,
+     * so the destructor never waits for rows that will not be submitted.
+     */
+    ~ImageWriter();
+
+    /**
+     * Blocks until the supplied row (0 is the top row) may be rendered, then returns a buffer for
+     * it: width pixels, each three floats (red, green, blue).
+     */
+    std::vector<float> acquireRow(uint row);
+
+    /** Hands a rendered row (linear color, as returned by acquireRow()) over to be written. */
+    void submitRow(uint row, std::vector<float>&& pixels);
+
+    /**
+     * Waits until every row has been written. Rethrows the error (std::ios_base::failure) if the
+     * stream failed.
+     */
+    void finish();
+
+    /**
+     * Stops writing without waiting for the rows still missing: the writer thread stops after the
+     * row it is writing, rows not yet written are dropped, and acquireRow() no longer blocks.
+     */
+    void abort();
+
+private:
+    std::ostream& _os;
+    uint _width;
+    uint _height;
+    uint _maxRowsInFlight;
+
+    std::mutex _mutex;
+    std::condition_variable _rowSubmitted;
+    std::condition_variable _rowWritten;
+    std::map<uint, std::vector<float>> _submittedRows;  // waiting to be written, by row
+    std::vector<std::vector<float>> _freeRows;          // buffers to reuse
+    uint _nbrOfRowsWritten;
+    bool _isAborted;
+    std::exception_ptr _error;
+
+    std::thread _thread;
+
+    void writeRows();
+};
@@ -0,0 +1,65 @@
+#include "Integrator.h"
+
+#include <cfloat>
+
+#include "HitableObject.h"
+#include "Material.h"
+#include "Random.h"
+
+const Vec3 BLACK(0.0f, 0.0f, 0.0f);
+const Vec3 BLUE(0.5f, 0.7f, 1.0f);
+const Vec3 WHITE(1.0f, 1.0f, 1.0f);
+
+/**
+ * Returns the color seen along the supplied ray: the ray is scattered off the objects it hits until
+ * it either escapes to the sky or is absorbed. Safe to call from several threads at once.
+ */
+Vec3 calculateColor(const Ray& r, const HitableCollection* world, int depth)
+{
+    HitableProperties properties;
+
+    if (world->hit(r, MIN_HIT_DISTANCE, FLT_MAX, properties)) {
+        return calculateHitColor(r, properties, world, depth);
+    }
+    else {
+        return skyColor(r);
+    }
+}
+
+/**
+ * Returns the color seen along a ray that hit an object (described by properties): the ray is
+ * scattered off the object and traced on through the world, as calculateColor() does.
+ */
+Vec3 calculateHitColor(const Ray& r, const HitableProperties& properties, const HitableCollection* world, int depth)
+{
+    Ray scatteredRay;
+    Vec3 rayAttenuation;
+
+    if (depth < 50 && properties.material->scatter(r, properties, scatteredRay, rayAttenuation)) {
+        return rayAttenuation * calculateColor(scatteredRay, world, depth + 1);
+    }
+    else {
+        return BLACK;
+    }
+}
+
+/** Returns the color of the sky seen along a ray that hits nothing. */
+Vec3 skyColor(const Ray& r)
+{
+    // blended_value = (1 - t) * start_value + t * end_value; t goes from 0 to 1
+    Vec3 unitDirection = Vec3::unitVector(r.direction());
+    float t = 0.5 * (unitDirection.y() + 1.0);
+    Vec3 blendedColorValue = ((1.0 - t) * WHITE) + (t * BLUE);
+    return blendedColorValue;
+}
+
+/** Takes a single (jittered) sample for pixel (i, j). */
+Vec3 samplePixel(const Camera& camera, const HitableCollection* world, uint i, uint j,
+                 uint imageWidth, uint imageHeight)
+{
+    float u = (i + randomFloat()) / float(imageWidth);
+    float v = (j + randomFloat()) / float(imageHeight);
+
+    Ray r = camera.calculateRay(u, v);
+    return calculateColor(r, world, 0);
+}
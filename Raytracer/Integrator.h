@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Camera.h"
+#include "HitableCollection.h"
+#include "Ray.h"
+#include "Vec3.h"
+
+// Hits nearer than this to a ray's origin are ignored, so rays don't hit the surface they left.
+const float MIN_HIT_DISTANCE = 0.00001f;
+
+/**
+ * Returns the color seen along the supplied ray: the ray is scattered off the objects it hits until
+ * it either escapes to the sky or is absorbed. Safe to call from several threads at once.
+ */
+Vec3 calculateColor(const Ray& r, const HitableCollection* world, int depth);
+
+/**
+ * Returns the color seen along a ray that hit an object (described by properties): the ray is
+ * scattered off the object and traced on through the world, as calculateColor() does.
+ */
+Vec3 calculateHitColor(const Ray& r, const HitableProperties& properties, const HitableCollection* world, int depth);
+
+/** Returns the color of the sky seen along a ray that hits nothing. */
+Vec3 skyColor(const Ray& r);
+
+/** Takes a single (jittered) sample for pixel (i, j). */
+Vec3 samplePixel(const Camera& camera, const HitableCollection* world, uint i, uint j,
+                 uint imageWidth, uint imageHeight);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "HitableObject.h"
+#include "Random.h"
 #include "Ray.h"
 #include "Vec3.h"
 
@@ -128,7 +129,7 @@ public:
             probabilityOfReflection = 1.0f;
         }
 
-        if (drand48() < probabilityOfReflection) {
+        if (randomFloat() < probabilityOfReflection) {
             scatteredRay = Ray(hitRecord.p, reflected);
         }
         else {
@@ -187,9 +188,9 @@ inline Vec3 randomPointInUnitSphere()
     Vec3 point;
 
     do {
-        float x = drand48();
-        float y = drand48();
-        float z = drand48();
+        float x = randomFloat();
+        float y = randomFloat();
+        float z = randomFloat();
         point = 2 * Vec3(x, y, z) - Vec3(1.0f, 1.0f, 1.0f);
     }
     while (point.squaredLength() >= 1);
@@ -0,0 +1,129 @@
+#include "NumaTopology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Parses a Linux cpulist such as "0-7,16-23" (node lists use the same format).
+std::vector<uint> parseCpuList(const std::string& cpuList)
+{
+    std::vector<uint> cpus;
+    std::istringstream listStream(cpuList);
+    std::string range;
+
+    while (std::getline(listStream, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+            uint first = uint(std::stoul(range.substr(0, dash)));
+            uint last = (dash == std::string::npos) ? first : uint(std::stoul(range.substr(dash + 1)));
+            for (uint cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (std::logic_error&) {     // blank or malformed range
+        }
+    }
+
+    return cpus;
+}
+
+}
+
+/** Detects the machine's NUMA nodes (Linux only; elsewhere a single node is returned). */
+NumaTopology NumaTopology::detect()
+{
+    NumaTopology topology;
+
+#ifdef __linux__
+    // Online node ids can have gaps (e.g., "0,2-3" with node 1 offline).
+    std::ifstream onlineFile("/sys/devices/system/node/online");
+    std::string onlineList;
+    if (onlineFile && std::getline(onlineFile, onlineList)) {
+        for (uint nodeId : parseCpuList(onlineList)) {
+            std::ifstream cpuListFile("/sys/devices/system/node/node" + std::to_string(nodeId) + "/cpulist");
+            std::string cpuList;
+            if (!cpuListFile || !std::getline(cpuListFile, cpuList)) {
+                continue;
+            }
+
+            std::vector<uint> cpus = parseCpuList(cpuList);
+            if (!cpus.empty()) {    // skip memory-only nodes
+                topology._nodeCpus.push_back(cpus);
+                topology._nodeIds.push_back(nodeId);
+            }
+        }
+    }
+#endif
+
+    if (topology._nodeCpus.empty()) {
+        std::vector<uint> cpus;
+        for (uint cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+            cpus.push_back(cpu);
+        }
+        topology._nodeCpus.push_back(cpus);
+        topology._nodeIds.push_back(0);
+    }
+
+    return topology;
+}
+
+/** Returns the total number of CPUs over all nodes. */
+uint NumaTopology::nbrOfCpus() const
+{
+    uint nbrOfCpus = 0;
+    for (const auto& cpus : _nodeCpus) {
+        nbrOfCpus += uint(cpus.size());
+    }
+    return nbrOfCpus;
+}
+
+/**
+ * Pins the calling thread to the CPUs of the supplied node. Does nothing (and returns false) on
+ * single node machines and on platforms without thread affinity.
+ */
+bool NumaTopology::pinCurrentThread(uint node) const
+{
+    if (nbrOfNodes() < 2) {
+        return false;
+    }
+
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (uint cpu : _nodeCpus[node]) {
+        CPU_SET(cpu, &cpuSet);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Runs task(node) once for every node, each on a thread pinned to that node, so that anything
+ * the task allocates is local to its node. Returns once every node's task has finished.
+ */
+void NumaTopology::runOnEachNode(const std::function<void(uint node)>& task) const
+{
+    std::vector<std::thread> threads;
+    for (uint node = 0; node < nbrOfNodes(); ++node) {
+        threads.emplace_back([this, &task, node] {
+            pinCurrentThread(node);
+            task(node);
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <functional>
+#include <vector>
+
+/**
+ * Render throughput of one NUMA node's threads.
+ */
+struct NodeStatistics
+{
+    uint nbrOfThreads;
+    unsigned long long nbrOfTasks;
+    unsigned long long nbrOfSamples;
+    double busySeconds;     // summed over the node's threads
+
+    /** Samples per busy second. */
+    double samplesPerSecond() const { return busySeconds > 0.0 ? nbrOfSamples / busySeconds : 0.0; }
+};
+
+/**
+ * The machine's NUMA nodes and the CPUs that belong to each. On machines (or platforms) that don't
+ * report NUMA information, every CPU belongs to a single node.
+ *
+ * Nodes are numbered 0 to nbrOfNodes() - 1 here; only nodes with CPUs are included, so these
+ * numbers can differ from the operating system's node ids (see nodeId()).
+ *
+ * Node-local memory is obtained by first touch: memory is placed on the node of the thread that
+ * first writes to it, so data built by a thread pinned to a node stays local to that node.
+ */
+class NumaTopology final
+{
+public:
+    /** Detects the machine's NUMA nodes (Linux only; elsewhere a single node is returned). */
+    static NumaTopology detect();
+
+    uint nbrOfNodes() const { return uint(_nodeCpus.size()); }
+
+    /** Returns the total number of CPUs over all nodes. */
+    uint nbrOfCpus() const;
+
+    /** Returns the CPUs that belong to the supplied node. */
+    const std::vector<uint>& cpus(uint node) const { return _nodeCpus[node]; }
+
+    /** Returns the operating system's id for the supplied node. */
+    uint nodeId(uint node) const { return _nodeIds[node]; }
+
+    /**
+     * Pins the calling thread to the CPUs of the supplied node. Does nothing (and returns false) on
+     * single node machines and on platforms without thread affinity.
+     */
+    bool pinCurrentThread(uint node) const;
+
+    /**
+     * Runs task(node) once for every node, each on a thread pinned to that node, so that anything
+     * the task allocates is local to its node. Returns once every node's task has finished.
+     */
+    void runOnEachNode(const std::function<void(uint node)>& task) const;
+
+private:
+    std::vector<std::vector<uint>> _nodeCpus;
+    std::vector<uint> _nodeIds;
+};
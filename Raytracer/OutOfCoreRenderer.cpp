@@ -0,0 +1,341 @@
+#include "OutOfCoreRenderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <utility>
+#include <vector>
+
+#include "HitableObject.h"
+#include "Integrator.h"
+#include "Random.h"
+#include "Sphere.h"
+
+// Paths traced together; bounds the memory used for rays and chunk queues.
+const uint PATHS_PER_BATCH = 1 << 16;
+
+// As in calculateColor().
+const uint MAX_DEPTH = 50;
+
+// Chunks per ChunkTree leaf.
+const uint CHUNKS_PER_LEAF = 4;
+
+namespace {
+
+// A path being traced: the ray for its next bounce and the attenuation gathered so far.
+struct Path
+{
+    Ray ray;
+    Vec3 attenuation;
+    Vec3 color;             // valid once the path is no longer alive
+    uint pixel;             // j * width + i
+    uint depth;
+    bool isAlive;
+
+    // Nearest hit found so far in the current pass (properties.t is FLT_MAX if there is none).
+    HitableProperties nearest;
+    MaterialDescription nearestMaterial;
+};
+
+// A ray queued on a chunk, with the distance at which it enters the chunk's bounding box.
+struct QueuedRay
+{
+    uint path;
+    float entryT;
+};
+
+// A node of a ChunkTree: a box around either two child nodes or a few chunks.
+struct ChunkTreeNode
+{
+    Vec3 boundsMin;
+    Vec3 boundsMax;
+    uint secondChild;       // the first child directly follows its parent; 0 for a leaf
+    uint firstChunk;        // a leaf's chunks are [firstChunk, endChunk) of the tree's chunk order
+    uint endChunk;
+};
+
+// A bounding volume hierarchy over the chunks' bounding boxes, so a ray only has to be tested
+// against the boxes of the chunks near its path rather than against every chunk.
+class ChunkTree final
+{
+public:
+    explicit ChunkTree(const std::vector<ChunkInfo>& chunks);
+
+    // Calls visit(chunkId, entryT) for each chunk whose bounding box the ray crosses within
+    // (tMin, FLT_MAX).
+    template <typename Visit>
+    void forEachCrossedChunk(const Ray& r, float tMin, Visit visit) const;
+
+private:
+    const std::vector<ChunkInfo>& _chunks;
+    std::vector<uint> _order;               // chunk ids, grouped by leaf
+    std::vector<ChunkTreeNode> _nodes;      // the root first
+
+    void build(uint begin, uint end);
+};
+
+}
+
+// Returns true if the ray crosses the box within (tMin, tMax); entryT is set to where it enters.
+static bool hitBox(const Ray& r, const Vec3& boundsMin, const Vec3& boundsMax, float tMin, float tMax,
+                   float& entryT)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        float inverseDirection = 1.0f / r.direction()[axis];
+        float t0 = (boundsMin[axis] - r.origin()[axis]) * inverseDirection;
+        float t1 = (boundsMax[axis] - r.origin()[axis]) * inverseDirection;
+        if (inverseDirection < 0.0f) {
+            std::swap(t0, t1);
+        }
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+        if (tMax < tMin) {
+            return false;
+        }
+    }
+    entryT = tMin;
+    return true;
+}
+
+// Builds the tree over all the chunks.
+ChunkTree::ChunkTree(const std::vector<ChunkInfo>& chunks)
+        : _chunks(chunks),
+          _order(chunks.size())
+{
+    for (uint c = 0; c < _order.size(); ++c) {
+        _order[c] = c;
+    }
+    if (!_order.empty()) {
+        build(0, uint(_order.size()));
+    }
+}
+
+// Adds the node for the chunks [begin, end) of _order, and the nodes below it.
+void ChunkTree::build(uint begin, uint end)
+{
+    uint node = uint(_nodes.size());
+    _nodes.push_back(ChunkTreeNode{_chunks[_order[begin]].boundsMin, _chunks[_order[begin]].boundsMax, 0, begin, end});
+    for (uint c = begin; c < end; ++c) {
+        const ChunkInfo& chunk = _chunks[_order[c]];
+        for (int axis = 0; axis < 3; ++axis) {
+            _nodes[node].boundsMin[axis] = std::min(_nodes[node].boundsMin[axis], chunk.boundsMin[axis]);
+            _nodes[node].boundsMax[axis] = std::max(_nodes[node].boundsMax[axis], chunk.boundsMax[axis]);
+        }
+    }
+    if (end - begin <= CHUNKS_PER_LEAF) {
+        return;
+    }
+
+    // Split at the median of the boxes' centers along the node's longest axis.
+    Vec3 extent = _nodes[node].boundsMax - _nodes[node].boundsMin;
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) {
+        if (extent[a] > extent[axis]) {
+            axis = a;
+        }
+    }
+    uint middle = begin + (end - begin) / 2;
+    std::nth_element(_order.begin() + begin, _order.begin() + middle, _order.begin() + end, [&](uint a, uint b) {
+        return _chunks[a].boundsMin[axis] + _chunks[a].boundsMax[axis] <
+               _chunks[b].boundsMin[axis] + _chunks[b].boundsMax[axis];
+    });
+
+    build(begin, middle);
+    _nodes[node].secondChild = uint(_nodes.size());
+    build(middle, end);
+}
+
+// Calls visit(chunkId, entryT) for each chunk whose bounding box the ray crosses within
+// (tMin, FLT_MAX).
+template <typename Visit>
+void ChunkTree::forEachCrossedChunk(const Ray& r, float tMin, Visit visit) const
+{
+    if (_nodes.empty()) {
+        return;
+    }
+
+    uint stack[64];
+    uint stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        uint nodeIndex = stack[--stackSize];
+        const ChunkTreeNode& node = _nodes[nodeIndex];
+        float entryT;
+        if (!hitBox(r, node.boundsMin, node.boundsMax, tMin, FLT_MAX, entryT)) {
+            continue;
+        }
+
+        if (node.secondChild == 0) {
+            for (uint c = node.firstChunk; c < node.endChunk; ++c) {
+                const ChunkInfo& chunk = _chunks[_order[c]];
+                if (hitBox(r, chunk.boundsMin, chunk.boundsMax, tMin, FLT_MAX, entryT)) {
+                    visit(chunk.id, entryT);
+                }
+            }
+        }
+        else {
+            stack[stackSize++] = node.secondChild;
+            stack[stackSize++] = nodeIndex + 1;
+        }
+    }
+}
+
+/**
+ * Renders a chunked scene that doesn't have to fit in memory, taking nbrOfSamples samples for every
+ * pixel of the frame buffer.
+ *
+ * Paths are traced a batch at a time, one bounce per pass. Each pass queues every live ray on the
+ * chunks whose bounding boxes it crosses (found through a bounding volume hierarchy over the
+ * chunks' boxes), then visits the chunks one after another, paging each
+ * one in once and testing all of its queued rays against it. Chunks that are already in memory are
+ * visited first, so chunks kept from the previous pass are used before they can be evicted.
+ *
+ * Returns the number of passes taken. Throws std::runtime_error if a chunk can't be read.
+ */
+uint renderOutOfCore(const Camera& camera, ChunkCache& chunks, FrameBuffer& frameBuffer, uint nbrOfSamples,
+                     ThreadPool& pool)
+{
+    const uint imageWidth = frameBuffer.width();
+    const uint imageHeight = frameBuffer.height();
+    const std::vector<ChunkInfo>& index = chunks.chunks();
+    const size_t nbrOfPaths = size_t(imageWidth) * imageHeight * nbrOfSamples;
+
+    const ChunkTree chunkTree(index);
+
+    std::vector<Path> paths;
+    uint nbrOfPasses = 0;
+
+    for (size_t batchStart = 0; batchStart < nbrOfPaths; batchStart += PATHS_PER_BATCH) {
+        paths.resize(std::min(size_t(PATHS_PER_BATCH), nbrOfPaths - batchStart));
+
+        // Start a path for each sample of the batch; a pixel's samples are consecutive.
+        pool.parallelFor(paths.size(), [&](size_t, size_t begin, size_t end) {
+            for (size_t p = begin; p < end; ++p) {
+                Path& path = paths[p];
+                path.pixel = uint((batchStart + p) / nbrOfSamples);
+                uint i = path.pixel % imageWidth;
+                uint j = path.pixel / imageWidth;
+                float u = (i + randomFloat()) / float(imageWidth);
+                float v = (j + randomFloat()) / float(imageHeight);
+                path.ray = camera.calculateRay(u, v);
+                path.attenuation = Vec3(1.0f, 1.0f, 1.0f);
+                path.depth = 0;
+                path.isAlive = true;
+            }
+        });
+
+        bool anyAlive = true;
+        while (anyAlive) {
+            nbrOfPasses++;
+
+            // Queue each live ray on every chunk it could hit. Each slice lists its rays' chunks
+            // separately; the lists are then sorted by chunk into one array, with each chunk's queue
+            // in path order.
+            std::vector<std::vector<std::pair<uint, QueuedRay>>> sliceQueued(pool.nbrOfSlices(paths.size()));
+            pool.parallelFor(paths.size(), [&](size_t slice, size_t begin, size_t end) {
+                for (size_t p = begin; p < end; ++p) {
+                    Path& path = paths[p];
+                    if (!path.isAlive) {
+                        continue;
+                    }
+                    path.nearest.t = FLT_MAX;
+                    chunkTree.forEachCrossedChunk(path.ray, MIN_HIT_DISTANCE, [&](uint id, float entryT) {
+                        sliceQueued[slice].push_back(std::make_pair(id, QueuedRay{uint(p), entryT}));
+                    });
+                }
+            });
+
+            // queueStarts[id] is where chunk id's queue starts in queued; it ends where the next
+            // chunk's starts.
+            std::vector<size_t> queueStarts(index.size() + 1, 0);
+            for (const auto& sliceList : sliceQueued) {
+                for (const auto& entry : sliceList) {
+                    queueStarts[entry.first + 1]++;
+                }
+            }
+            for (size_t id = 0; id < index.size(); ++id) {
+                queueStarts[id + 1] += queueStarts[id];
+            }
+            std::vector<QueuedRay> queued(queueStarts.back());
+            std::vector<size_t> queueEnds(queueStarts.begin(), queueStarts.end() - 1);
+            for (const auto& sliceList : sliceQueued) {
+                for (const auto& entry : sliceList) {
+                    queued[queueEnds[entry.first]++] = entry.second;
+                }
+            }
+            sliceQueued.clear();
+            auto isQueuedOn = [&](uint id) { return queueStarts[id + 1] > queueStarts[id]; };
+
+            // Visit the chunks that are still in memory first.
+            std::vector<uint> order;
+            for (uint id = 0; id < index.size(); ++id) {
+                if (isQueuedOn(id) && chunks.isResident(id)) {
+                    order.push_back(id);
+                }
+            }
+            for (uint id = 0; id < index.size(); ++id) {
+                if (isQueuedOn(id) && !chunks.isResident(id)) {
+                    order.push_back(id);
+                }
+            }
+
+            for (uint id : order) {
+                std::shared_ptr<const Chunk> chunk = chunks.load(id);
+                const QueuedRay* queue = &queued[queueStarts[id]];
+
+                pool.parallelFor(queueStarts[id + 1] - queueStarts[id], [&](size_t, size_t begin, size_t end) {
+                    for (size_t q = begin; q < end; ++q) {
+                        Path& path = paths[queue[q].path];
+                        if (queue[q].entryT >= path.nearest.t) {
+                            continue;   // something nearer was already hit
+                        }
+                        for (const SphereDescription& sphere : *chunk) {
+                            Sphere shape(sphere.center, sphere.radius, nullptr);
+                            if (shape.hit(path.ray, MIN_HIT_DISTANCE, path.nearest.t, path.nearest)) {
+                                path.nearestMaterial = sphere.material;
+                            }
+                        }
+                    }
+                });
+            }
+
+            // Scatter the rays off whatever they hit; rays that hit nothing see the sky.
+            std::atomic<bool> isAnyAlive(false);
+            pool.parallelFor(paths.size(), [&](size_t, size_t begin, size_t end) {
+                for (size_t p = begin; p < end; ++p) {
+                    Path& path = paths[p];
+                    if (!path.isAlive) {
+                        continue;
+                    }
+
+                    if (path.nearest.t == FLT_MAX) {
+                        path.color = path.attenuation * skyColor(path.ray);
+                        path.isAlive = false;
+                        continue;
+                    }
+
+                    Ray scatteredRay;
+                    Vec3 rayAttenuation;
+                    if (path.depth < MAX_DEPTH &&
+                            scatter(path.nearestMaterial, path.ray, path.nearest, scatteredRay, rayAttenuation)) {
+                        path.ray = scatteredRay;
+                        path.attenuation = path.attenuation * rayAttenuation;
+                        path.depth++;
+                        isAnyAlive = true;
+                    }
+                    else {
+                        path.color = Vec3(0.0f, 0.0f, 0.0f);
+                        path.isAlive = false;
+                    }
+                }
+            });
+            anyAlive = isAnyAlive;
+        }
+
+        for (const Path& path : paths) {
+            frameBuffer.addSample(path.pixel % imageWidth, path.pixel / imageWidth, path.color);
+        }
+    }
+
+    return nbrOfPasses;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Camera.h"
+#include "ChunkedScene.h"
+#include "FrameBuffer.h"
+#include "ThreadPool.h"
+
+/**
+ * Renders a chunked scene that doesn't have to fit in memory, taking nbrOfSamples samples for every
+ * pixel of the frame buffer.
+ *
+ * Paths are traced a batch at a time, one bounce per pass. Each pass queues every live ray on the
+ * chunks whose bounding boxes it crosses (found through a bounding volume hierarchy over the
+ * chunks' boxes), then visits the chunks one after another, paging each
+ * one in once and testing all of its queued rays against it. Chunks that are already in memory are
+ * visited first, so chunks kept from the previous pass are used before they can be evicted.
+ *
+ * Returns the number of passes taken. Throws std::runtime_error if a chunk can't be read.
+ */
+uint renderOutOfCore(const Camera& camera, ChunkCache& chunks, FrameBuffer& frameBuffer, uint nbrOfSamples,
+                     ThreadPool& pool);
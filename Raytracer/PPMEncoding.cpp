@@ -0,0 +1,35 @@
+#include "PPMEncoding.h"
+
+#include <cmath>
+#include <vector>
+
+/**
+ * Gamma corrects a row of linear colors (three floats per pixel) and appends it to the supplied
+ * string as plain .ppm text, one pixel per line. Values outside [0, 1] are clamped to it, and NaN
+ * is written as 0.
+ */
+void encodePPMRow(const float* pixels, uint width, std::string& text)
+{
+    // Convert the whole row first, in one tight loop over plain arrays that the compiler can
+    // vectorize, then format the integers.
+    const uint nbrOfValues = 3 * width;
+    std::vector<int> values(nbrOfValues);
+    for (uint v = 0; v < nbrOfValues; ++v) {
+        // Written so that NaN fails both comparisons and ends up 0.
+        float value = pixels[v] > 0.0f ? pixels[v] : 0.0f;
+        value = value < 1.0f ? value : 1.0f;
+        values[v] = int(255.99999f * sqrtf(value));         // gamma correction
+    }
+
+    for (uint v = 0; v < nbrOfValues; ++v) {
+        int value = values[v];
+        if (value >= 100) {
+            text += char('0' + value / 100);
+        }
+        if (value >= 10) {
+            text += char('0' + value / 10 % 10);
+        }
+        text += char('0' + value % 10);
+        text += (v % 3 == 2) ? '\n' : ' ';
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Gamma corrects a row of linear colors (three floats per pixel) and appends it to the supplied
+ * string as plain .ppm text, one pixel per line. Values outside [0, 1] are clamped to it, and NaN
+ * is written as 0.
+ */
+void encodePPMRow(const float* pixels, uint width, std::string& text);
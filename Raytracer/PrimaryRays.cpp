@@ -0,0 +1,92 @@
+#include "PrimaryRays.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include "Integrator.h"
+#include "Random.h"
+
+// Each tile's lens points are jittered over a LENS_STRATA x LENS_STRATA grid.
+const uint LENS_STRATA = 16;
+
+/** Sets up the primary rays of a tile of an imageWidth x imageHeight image. */
+PrimaryRays::PrimaryRays(const Camera& camera, const HitableCollection* world, const Tile& tile,
+                         uint imageWidth, uint imageHeight)
+        : _world(world),
+          _tile(tile),
+          _lensCenter(camera.lensCenter())
+{
+    float s0 = float(tile.startI) / float(imageWidth);
+    float s1 = float(tile.endI) / float(imageWidth);
+    float t0 = float(tile.startJ) / float(imageHeight);
+    float t1 = float(tile.endJ) / float(imageHeight);
+
+    _tileDirection = camera.directionTo(s0, t0);
+    _pixelStepI = camera.directionTo(s0 + 1.0f / float(imageWidth), t0) - _tileDirection;
+    _pixelStepJ = camera.directionTo(s0, t0 + 1.0f / float(imageHeight)) - _tileDirection;
+
+    // One lens point per stratum, shuffled so that consecutive samples come from scattered strata.
+    _lensOffsets.reserve(LENS_STRATA * LENS_STRATA);
+    for (uint a = 0; a < LENS_STRATA; ++a) {
+        for (uint b = 0; b < LENS_STRATA; ++b) {
+            _lensOffsets.push_back(camera.lensOffset((a + randomFloat()) / LENS_STRATA,
+                                                     (b + randomFloat()) / LENS_STRATA));
+        }
+    }
+    std::shuffle(_lensOffsets.begin(), _lensOffsets.end(), randomEngine());
+
+    for (const HitableObject* object : world->objects()) {
+        Vec3 center;
+        float radius;
+        object->boundingSphere(center, radius);
+        if (camera.couldSee(center, radius, s0, t0, s1, t1)) {
+            _visibleObjects.push_back(object);
+        }
+    }
+}
+
+/**
+ * Takes nbrOfSamples (jittered) samples for each pixel of row j of the tile. Sample s of pixel i
+ * is returned in samples[(i - tile.startI) * nbrOfSamples + s].
+ */
+void PrimaryRays::traceRow(uint j, uint nbrOfSamples, std::vector<Vec3>& samples) const
+{
+    samples.resize((_tile.endI - _tile.startI) * nbrOfSamples);
+
+    Vec3 pixelDirection = _tileDirection + float(j - _tile.startJ) * _pixelStepJ;
+    for (uint i = _tile.startI; i < _tile.endI; ++i) {
+        // Each pixel starts at a random place in the lens point set.
+        size_t lensSample = size_t(randomFloat() * _lensOffsets.size()) % _lensOffsets.size();
+
+        for (uint s = 0; s < nbrOfSamples; ++s) {
+            const Vec3& lensOffset = _lensOffsets[lensSample];
+            if (++lensSample == _lensOffsets.size()) {
+                lensSample = 0;
+            }
+
+            Vec3 direction = pixelDirection + randomFloat() * _pixelStepI + randomFloat() * _pixelStepJ - lensOffset;
+            samples[(i - _tile.startI) * nbrOfSamples + s] = calculateColor(Ray(_lensCenter + lensOffset, direction));
+        }
+
+        pixelDirection += _pixelStepI;
+    }
+}
+
+// As ::calculateColor(), but the first hit is only looked for among the visible objects.
+Vec3 PrimaryRays::calculateColor(const Ray& r) const
+{
+    bool didHit = false;
+    HitableProperties properties;
+    HitableProperties tempProperties;
+    float nearestHitSoFar = FLT_MAX;
+
+    for (const HitableObject* object : _visibleObjects) {
+        if (object->hit(r, MIN_HIT_DISTANCE, nearestHitSoFar, tempProperties)) {
+            didHit = true;
+            nearestHitSoFar = tempProperties.t;
+            properties = tempProperties;
+        }
+    }
+
+    return didHit ? calculateHitColor(r, properties, _world, 0) : skyColor(r);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "Camera.h"
+#include "HitableCollection.h"
+#include "Tile.h"
+#include "Vec3.h"
+
+/**
+ * Primary ray setup for one tile, done once so that each sample's primary ray costs little:
+ *
+ * - Ray directions are stepped across the tile a pixel at a time, rather than computed from the
+ *   camera for every sample.
+ * - Lens points come from a stratified set made for the tile, rather than from rejection sampling.
+ * - First hits are only tested against the objects the camera can see through the tile (see
+ *   Camera::couldSee()). Rays that bounce go on through the whole world.
+ *
+ * Safe to use from several threads at once.
+ */
+class PrimaryRays final
+{
+public:
+    /** Sets up the primary rays of a tile of an imageWidth x imageHeight image. */
+    PrimaryRays(const Camera& camera, const HitableCollection* world, const Tile& tile,
+                uint imageWidth, uint imageHeight);
+
+    PrimaryRays(const PrimaryRays& rhs) = delete;
+    PrimaryRays(PrimaryRays&& rhs) = delete;
+    PrimaryRays& operator=(const PrimaryRays& rhs) = delete;
+    PrimaryRays& operator=(PrimaryRays&& rhs) = delete;
+
+    /** Returns the number of objects first hits are tested against. */
+    size_t nbrOfVisibleObjects() const { return _visibleObjects.size(); }
+
+    /**
+     * Takes nbrOfSamples (jittered) samples for each pixel of row j of the tile. Sample s of pixel i
+     * is returned in samples[(i - tile.startI) * nbrOfSamples + s].
+     */
+    void traceRow(uint j, uint nbrOfSamples, std::vector<Vec3>& samples) const;
+
+private:
+    const HitableCollection* _world;
+    Tile _tile;
+
+    Vec3 _lensCenter;
+    Vec3 _tileDirection;    // direction to the lower left corner of the tile's lower left pixel
+    Vec3 _pixelStepI;       // change in direction from one pixel to the next along a row
+    Vec3 _pixelStepJ;       // change in direction from one row to the next
+
+    std::vector<Vec3> _lensOffsets;
+    std::vector<const HitableObject*> _visibleObjects;
+
+    Vec3 calculateColor(const Ray& r) const;
+};
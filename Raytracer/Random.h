@@ -0,0 +1,32 @@
+#pragma once
+
+#include <random>
+
+#include "Hash.h"
+
+/**
+ * Returns this thread's random number engine. Each thread gets its own engine, so render threads
+ * never share (or fight over) generator state.
+ */
+inline std::default_random_engine& randomEngine()
+{
+    thread_local std::default_random_engine engine(std::random_device{}());
+    return engine;
+}
+
+/**
+ * Reseeds this thread's random number engine, so that what it renders next is repeatable.
+ */
+inline void seedRandom(uint64_t seed)
+{
+    randomEngine().seed(std::default_random_engine::result_type(hashCombine(seed, uint64_t(0))));
+}
+
+/**
+ * Returns a random number in [0, 1) from this thread's random number engine.
+ */
+inline float randomFloat()
+{
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    return distribution(randomEngine());
+}
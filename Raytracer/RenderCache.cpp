@@ -0,0 +1,154 @@
+#include "RenderCache.h"
+
+/**
+ * Creates a new RenderCache.
+ * @param maxViews The number of views kept; the least recently used view is dropped first.
+ * 0 disables the cache.
+ * @param influenceRadius How far (in world units) from an edited object a change is assumed to
+ * be visible on the diffuse objects around it (through the light they bounce).
+ * @param reflectionDistance How far (in world units, surface to surface) from an edited object a
+ * metal or glass sphere is assumed to show it in its reflection or refraction.
+ * Both are approximations: surfaces further away can still change slightly.
+ */
+RenderCache::RenderCache(uint maxViews, float influenceRadius, float reflectionDistance)
+        : _maxViews(maxViews),
+          _influenceRadius(influenceRadius),
+          _reflectionDistance(reflectionDistance)
+{ }
+
+/** Changes the cache's settings (see the constructor), dropping every cached view. */
+void RenderCache::configure(uint maxViews, float influenceRadius, float reflectionDistance)
+{
+    _maxViews = maxViews;
+    _influenceRadius = influenceRadius;
+    _reflectionDistance = reflectionDistance;
+    _recentlyUsed.clear();
+    _views.clear();
+}
+
+/** Returns the cached view for the key (null if there isn't one), marking it recently used. */
+std::shared_ptr<const RenderCache::View> RenderCache::find(uint64_t viewKey)
+{
+    auto found = _views.find(viewKey);
+    if (found == _views.end()) {
+        return nullptr;
+    }
+
+    _recentlyUsed.splice(_recentlyUsed.begin(), _recentlyUsed, found->second.second);
+    return found->second.first;
+}
+
+/** Caches a view, dropping the least recently used view if the cache is full. */
+void RenderCache::store(uint64_t viewKey, std::shared_ptr<const View> view)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    auto found = _views.find(viewKey);
+    if (found != _views.end()) {
+        found->second.first = std::move(view);
+        _recentlyUsed.splice(_recentlyUsed.begin(), _recentlyUsed, found->second.second);
+        return;
+    }
+
+    if (_views.size() >= _maxViews) {
+        _views.erase(_recentlyUsed.back());
+        _recentlyUsed.pop_back();
+    }
+
+    _recentlyUsed.push_front(viewKey);
+    _views[viewKey] = std::make_pair(std::move(view), _recentlyUsed.begin());
+}
+
+/**
+ * Returns the spheres that were added, removed, or changed going from one scene to the other.
+ * Changed spheres are returned both as they were and as they are now.
+ */
+std::vector<SphereDescription> RenderCache::changedSpheres(const SceneObjects& before, const SceneObjects& after)
+{
+    std::vector<SphereDescription> changed;
+
+    // Both maps are ordered by object id, so walk them together.
+    auto b = before.begin();
+    auto a = after.begin();
+    while (b != before.end() || a != after.end()) {
+        if (a == after.end() || (b != before.end() && b->first < a->first)) {
+            changed.push_back(b->second);   // removed
+            ++b;
+        }
+        else if (b == before.end() || a->first < b->first) {
+            changed.push_back(a->second);   // added
+            ++a;
+        }
+        else {
+            if (hashSphere(b->second) != hashSphere(a->second)) {
+                changed.push_back(b->second);
+                changed.push_back(a->second);
+            }
+            ++b;
+            ++a;
+        }
+    }
+
+    return changed;
+}
+
+/**
+ * Returns the scene's metal and glass spheres that are within the reflection distance of a
+ * changed sphere, i.e., that could show the change in their reflections or refractions.
+ */
+std::vector<SphereDescription> RenderCache::reflectiveSpheres(const SceneObjects& objects,
+                                                              const std::vector<SphereDescription>& changedSpheres) const
+{
+    std::vector<SphereDescription> reflective;
+    for (const auto& object : objects) {
+        const SphereDescription& sphere = object.second;
+        if (sphere.material.type == MaterialDescription::Type::Lambertian) {
+            continue;
+        }
+        for (const auto& changed : changedSpheres) {
+            float gap = (sphere.center - changed.center).length() - sphere.radius - changed.radius;
+            if (gap <= _reflectionDistance) {
+                reflective.push_back(sphere);
+                break;
+            }
+        }
+    }
+    return reflective;
+}
+
+/**
+ * Returns false only if none of the changed spheres, grown by the influence radius, and none of
+ * the reflective spheres (see reflectiveSpheres()) can be seen from any pixel of the tile. With no
+ * changed spheres, nothing can affect the tile.
+ */
+bool RenderCache::couldAffect(const std::vector<SphereDescription>& changedSpheres,
+                              const std::vector<SphereDescription>& reflectiveSpheres, const Camera& camera,
+                              const RenderRegion& region, const Tile& tile) const
+{
+    if (changedSpheres.empty()) {
+        return false;
+    }
+
+    float s0 = float(tile.startI) / float(region.imageWidth);
+    float s1 = float(tile.endI) / float(region.imageWidth);
+    float t0 = float(tile.startJ) / float(region.imageHeight);
+    float t1 = float(tile.endJ) / float(region.imageHeight);
+
+    for (const auto& sphere : changedSpheres) {
+        if (camera.couldSee(sphere.center, sphere.radius + _influenceRadius, s0, t0, s1, t1)) {
+            return true;
+        }
+    }
+
+    // A mirror or a glass sphere near the change can show it from further away than the influence
+    // radius; only its own surface needs to be re-rendered.
+    for (const auto& sphere : reflectiveSpheres) {
+        if (camera.couldSee(sphere.center, sphere.radius, s0, t0, s1, t1)) {
+            return true;
+        }
+    }
+
+    return false;
+}
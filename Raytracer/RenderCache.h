@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "Camera.h"
+#include "RenderEngine.h"
+#include "Tile.h"
+
+/** A scene's objects as they were at one point in time. Shared, and never changed once built. */
+typedef std::map<ObjectId, SphereDescription> SceneObjects;
+
+/**
+ * Keeps the pixels of recent renders so that re-rendering a view after a scene edit only has to
+ * re-render the tiles the edit could have changed. Views are keyed by a hash of the scene id,
+ * camera, region, and render settings; each cached view remembers the scene it was rendered from,
+ * so the edits made since can be found.
+ *
+ * Not thread safe; the engine guards it with its own mutex.
+ */
+class RenderCache final
+{
+public:
+    struct View
+    {
+        uint64_t sceneHash;
+        std::shared_ptr<const SceneObjects> objects;
+        std::vector<float> pixels;      // as returned by RenderEngine::render()
+    };
+
+    /**
+     * Creates a new RenderCache.
+     * @param maxViews The number of views kept; the least recently used view is dropped first.
+     * 0 disables the cache.
+     * @param influenceRadius How far (in world units) from an edited object a change is assumed to
+     * be visible on the diffuse objects around it (through the light they bounce).
+     * @param reflectionDistance How far (in world units, surface to surface) from an edited object a
+     * metal or glass sphere is assumed to show it in its reflection or refraction.
+     * Both are approximations: surfaces further away can still change slightly.
+     */
+    RenderCache(uint maxViews, float influenceRadius, float reflectionDistance);
+
+    /** Changes the cache's settings (see the constructor), dropping every cached view. */
+    void configure(uint maxViews, float influenceRadius, float reflectionDistance);
+
+    bool isEnabled() const { return _maxViews > 0; }
+
+    /** Returns the cached view for the key (null if there isn't one), marking it recently used. */
+    std::shared_ptr<const View> find(uint64_t viewKey);
+
+    /** Caches a view, dropping the least recently used view if the cache is full. */
+    void store(uint64_t viewKey, std::shared_ptr<const View> view);
+
+    /**
+     * Returns the spheres that were added, removed, or changed going from one scene to the other.
+     * Changed spheres are returned both as they were and as they are now.
+     */
+    static std::vector<SphereDescription> changedSpheres(const SceneObjects& before, const SceneObjects& after);
+
+    /**
+     * Returns the scene's metal and glass spheres that are within the reflection distance of a
+     * changed sphere, i.e., that could show the change in their reflections or refractions.
+     */
+    std::vector<SphereDescription> reflectiveSpheres(const SceneObjects& objects,
+                                                     const std::vector<SphereDescription>& changedSpheres) const;
+
+    /**
+     * Returns false only if none of the changed spheres, grown by the influence radius, and none of
+     * the reflective spheres (see reflectiveSpheres()) can be seen from any pixel of the tile. With no
+     * changed spheres, nothing can affect the tile.
+     */
+    bool couldAffect(const std::vector<SphereDescription>& changedSpheres,
+                     const std::vector<SphereDescription>& reflectiveSpheres, const Camera& camera,
+                     const RenderRegion& region, const Tile& tile) const;
+
+private:
+    uint _maxViews;
+    float _influenceRadius;
+    float _reflectionDistance;
+
+    std::list<uint64_t> _recentlyUsed;  // view keys, most recently used first
+    std::unordered_map<uint64_t, std::pair<std::shared_ptr<const View>, std::list<uint64_t>::iterator>> _views;
+};
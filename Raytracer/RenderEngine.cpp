@@ -0,0 +1,398 @@
+#include "RenderEngine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "Camera.h"
+#include "Hash.h"
+#include "HitableCollection.h"
+#include "PrimaryRays.h"
+#include "Random.h"
+#include "RenderCache.h"
+#include "ThreadPool.h"
+#include "Tile.h"
+
+namespace {
+
+// Render cache defaults; see RenderEngine::configureRenderCache().
+const uint DEFAULT_CACHED_VIEWS = 16;
+const float DEFAULT_INFLUENCE_RADIUS = 2.0f;
+const float DEFAULT_REFLECTION_DISTANCE = 4.0f;
+
+// What a render needs from a scene as it was at one point: its objects, their hash, and one built
+// world per NUMA node.
+struct SceneVersion
+{
+    std::shared_ptr<const SceneObjects> objects;
+    uint64_t hash;
+    std::vector<std::shared_ptr<const HitableCollection>> worlds;
+};
+
+struct Scene
+{
+    SceneObjects objects;   // ordered, so rebuilds are deterministic
+    ObjectId nextObjectId = 1;
+
+    // Built on the first render after an edit. Renders hold on to the version they started with,
+    // so an edit only has to drop this pointer.
+    std::shared_ptr<const SceneVersion> version;
+
+    // Bumped by every edit, so that a version built without holding the engine's mutex can tell
+    // whether the scene changed while it was being built.
+    uint64_t nbrOfEdits = 0;
+};
+
+// Returns a key for everything that determines a render's pixels, other than the scene's contents.
+uint64_t hashView(SceneId scene, const CameraSettings& camera, const RenderRegion& region, uint nbrOfSamples)
+{
+    uint64_t hash = hashCombine(uint64_t(scene), uint64_t(nbrOfSamples));
+    for (int k = 0; k < 3; ++k) {
+        hash = hashCombine(hash, camera.lookFrom[k]);
+        hash = hashCombine(hash, camera.lookAt[k]);
+        hash = hashCombine(hash, camera.up[k]);
+    }
+    hash = hashCombine(hash, camera.vFov);
+    hash = hashCombine(hash, camera.aperture);
+    hash = hashCombine(hash, camera.focusDistance);
+
+    for (uint value : {region.imageWidth, region.imageHeight, region.startI, region.startJ, region.width, region.height}) {
+        hash = hashCombine(hash, uint64_t(value));
+    }
+    return hash;
+}
+
+// Copies one tile's pixels between two buffers laid out as for RenderEngine::render().
+void copyTile(const float* from, float* to, const RenderRegion& region, const Tile& tile)
+{
+    const uint regionTopJ = region.startJ + region.height - 1;
+    for (uint j = tile.startJ; j < tile.endJ; ++j) {
+        size_t first = 3 * (size_t(regionTopJ - j) * region.width + (tile.startI - region.startI));
+        std::copy(from + first, from + first + 3 * (tile.endI - tile.startI), to + first);
+    }
+}
+
+// Renders one tile of a region into the caller's buffer. The render's cancel flag is checked after
+// every row so that cancelled renders free up their threads quickly. Returns false if cancelled.
+// The random number engine is seeded from the view and the tile's position, so a tile renders
+// the same way every time (which is what lets the render cache mix new and cached tiles).
+bool renderRegionTile(const Camera& camera, const HitableCollection* world, const RenderRegion& region,
+                      const Tile& tile, uint nbrOfSamples, float* pixels, uint64_t viewKey,
+                      const std::atomic<bool>* cancelRequested)
+{
+    const uint regionTopJ = region.startJ + region.height - 1;
+    seedRandom(hashCombine(hashCombine(viewKey, uint64_t(tile.startI)), uint64_t(tile.startJ)));
+
+    PrimaryRays primaryRays(camera, world, tile, region.imageWidth, region.imageHeight);
+    std::vector<Vec3> samples;
+
+    for (uint j = tile.startJ; j < tile.endJ; ++j) {
+        if (cancelRequested != nullptr && *cancelRequested) {
+            return false;
+        }
+
+        primaryRays.traceRow(j, nbrOfSamples, samples);
+        for (uint i = tile.startI; i < tile.endI; ++i) {
+            Vec3 color(0.0f, 0.0f, 0.0f);
+            for (uint s = 0; s < nbrOfSamples; ++s) {
+                color += samples[(i - tile.startI) * nbrOfSamples + s];
+            }
+            color /= float(nbrOfSamples);
+            ThreadPool::countSamples(nbrOfSamples);
+
+            float* pixel = pixels + 3 * ((regionTopJ - j) * region.width + (i - region.startI));
+            pixel[0] = color[0];
+            pixel[1] = color[1];
+            pixel[2] = color[2];
+        }
+    }
+
+    return true;
+}
+
+}
+
+class RenderEngine::Impl
+{
+public:
+    Impl(uint nbrOfThreads)
+            : nextSceneId(1),
+              renderCache(DEFAULT_CACHED_VIEWS, DEFAULT_INFLUENCE_RADIUS, DEFAULT_REFLECTION_DISTANCE),
+              cacheStatistics{0, 0},
+              pool(nbrOfThreads)
+    { }
+
+    std::mutex mutex;   // guards everything below but the pool
+    std::map<SceneId, Scene> scenes;
+    SceneId nextSceneId;
+    RenderCache renderCache;
+    RenderCacheStatistics cacheStatistics;
+
+    // Declared last, so that it is destroyed (and its threads joined) first, while everything its
+    // tasks could use still exists.
+    ThreadPool pool;
+
+    // Must be called with the mutex held.
+    Scene& findScene(SceneId scene)
+    {
+        auto found = scenes.find(scene);
+        if (found == scenes.end()) {
+            throw std::invalid_argument("unknown scene " + std::to_string(scene));
+        }
+        return found->second;
+    }
+
+    // Must be called with the mutex held.
+    SphereDescription& findSphere(Scene& scene, ObjectId object)
+    {
+        auto found = scene.objects.find(object);
+        if (found == scene.objects.end()) {
+            throw std::invalid_argument("unknown object " + std::to_string(object));
+        }
+        return found->second;
+    }
+
+    // Returns the scene's current version, building it first if the scene has been edited since
+    // the last render. The worlds are built without holding the mutex, so edits, cache lookups, and
+    // renders of other scenes never wait for a build. If the scene is edited during the build, the
+    // version built is still returned (it is the scene as it was when the render started), but it
+    // isn't kept.
+    std::shared_ptr<const SceneVersion> version(SceneId sceneId)
+    {
+        std::shared_ptr<SceneVersion> version(new SceneVersion);
+        uint64_t nbrOfEdits = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Scene& scene = findScene(sceneId);
+            if (scene.version) {
+                return scene.version;
+            }
+            version->objects.reset(new SceneObjects(scene.objects));
+            nbrOfEdits = scene.nbrOfEdits;
+        }
+
+        version->hash = 0;
+        std::vector<SphereDescription> spheres;
+        spheres.reserve(version->objects->size());
+        for (const auto& object : *version->objects) {
+            spheres.push_back(object.second);
+            version->hash = hashCombine(hashCombine(version->hash, uint64_t(object.first)), hashSphere(object.second));
+        }
+        version->worlds = buildNodeLocalWorlds(pool.topology(), spheres);
+
+        // Keep the version unless the scene was edited (or destroyed) meanwhile; if another render
+        // built the same version first, share that one instead.
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = scenes.find(sceneId);
+        if (found != scenes.end() && found->second.nbrOfEdits == nbrOfEdits) {
+            if (!found->second.version) {
+                found->second.version = version;
+            }
+            return found->second.version;
+        }
+        return version;
+    }
+};
+
+/**
+ * Creates a new RenderEngine.
+ * @param nbrOfThreads The number of render threads; 0 creates one per hardware thread.
+ */
+RenderEngine::RenderEngine(uint nbrOfThreads) : _impl(new Impl(nbrOfThreads)) { }
+
+/**
+ * Stops the render threads. No render() may be running, or be called, while the engine is being
+ * destroyed; cancel running renders through their cancel flags and wait for them to return first.
+ */
+RenderEngine::~RenderEngine() { }
+
+/** Creates a new, empty scene. */
+SceneId RenderEngine::createScene()
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    SceneId scene = _impl->nextSceneId++;
+    _impl->scenes[scene];
+    return scene;
+}
+
+/** Destroys a scene. Renders of it that are already running finish normally. */
+void RenderEngine::destroyScene(SceneId scene)
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    _impl->findScene(scene);
+    _impl->scenes.erase(scene);
+}
+
+/** Adds a sphere to a scene, returning its id within the scene. */
+ObjectId RenderEngine::addSphere(SceneId sceneId, const SphereDescription& sphere)
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    Scene& scene = _impl->findScene(sceneId);
+
+    ObjectId object = scene.nextObjectId++;
+    scene.objects[object] = sphere;
+    scene.version.reset();
+    scene.nbrOfEdits++;
+    return object;
+}
+
+/** Replaces a sphere in a scene (e.g., to move it or change its material). */
+void RenderEngine::updateSphere(SceneId sceneId, ObjectId object, const SphereDescription& sphere)
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    Scene& scene = _impl->findScene(sceneId);
+
+    _impl->findSphere(scene, object) = sphere;
+    scene.version.reset();
+    scene.nbrOfEdits++;
+}
+
+/** Removes an object from a scene. */
+void RenderEngine::removeObject(SceneId sceneId, ObjectId object)
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    Scene& scene = _impl->findScene(sceneId);
+
+    _impl->findSphere(scene, object);
+    scene.objects.erase(object);
+    scene.version.reset();
+    scene.nbrOfEdits++;
+}
+
+/**
+ * Renders a region of a scene, blocking until it is done or cancelled.
+ * @param pixels Caller provided buffer of region.width * region.height pixels, each three floats
+ * (red, green, blue). Rows are stored top row first. Colors are the linear (not gamma
+ * corrected) average of the pixel's samples. If the render is cancelled, pixels that were not
+ * rendered are left untouched.
+ * @param cancelRequested Optional cancel flag for this render only. Setting it (from any thread)
+ * makes the render return RenderStatus::Cancelled as soon as the rows it is working on are
+ * finished. Other renders are not affected.
+ */
+RenderStatus RenderEngine::render(SceneId scene, const CameraSettings& cameraSettings, const RenderRegion& region,
+                                  uint nbrOfSamples, float* pixels, const std::atomic<bool>* cancelRequested)
+{
+    if (region.width == 0 || region.height == 0 || nbrOfSamples == 0 ||
+        region.startI + region.width > region.imageWidth || region.startJ + region.height > region.imageHeight) {
+        throw std::invalid_argument("render region is empty or outside of the image");
+    }
+
+    std::shared_ptr<const SceneVersion> version = _impl->version(scene);
+    const uint64_t viewKey = hashView(scene, cameraSettings, region, nbrOfSamples);
+
+    Camera camera(cameraSettings.lookFrom, cameraSettings.lookAt, cameraSettings.up, cameraSettings.vFov,
+                  float(region.imageWidth) / float(region.imageHeight),
+                  cameraSettings.aperture, cameraSettings.focusDistance);
+
+    std::vector<Tile> tiles = splitIntoTiles(region.width, region.height);
+    for (Tile& tile : tiles) {
+        tile.startI += region.startI;
+        tile.endI += region.startI;
+        tile.startJ += region.startJ;
+        tile.endJ += region.startJ;
+    }
+
+    // If this view was rendered before, reuse the cached tiles that no change to the scene since
+    // could have reached, and render the rest.
+    std::vector<Tile> tilesToRender;
+    {
+        std::lock_guard<std::mutex> lock(_impl->mutex);
+        std::shared_ptr<const RenderCache::View> cachedView = _impl->renderCache.find(viewKey);
+
+        std::vector<SphereDescription> changedSpheres;
+        std::vector<SphereDescription> reflectiveSpheres;
+        if (cachedView && cachedView->sceneHash != version->hash) {
+            // Reflective spheres that were changed or removed are among the changed spheres.
+            changedSpheres = RenderCache::changedSpheres(*cachedView->objects, *version->objects);
+            reflectiveSpheres = _impl->renderCache.reflectiveSpheres(*version->objects, changedSpheres);
+        }
+
+        for (const Tile& tile : tiles) {
+            if (cachedView &&
+                    !_impl->renderCache.couldAffect(changedSpheres, reflectiveSpheres, camera, region, tile)) {
+                copyTile(cachedView->pixels.data(), pixels, region, tile);
+            }
+            else {
+                tilesToRender.push_back(tile);
+            }
+        }
+    }
+
+    std::mutex doneMutex;
+    std::condition_variable allTilesDone;
+    std::atomic<uint> nbrOfRemainingTiles(uint(tilesToRender.size()));
+    std::atomic<bool> wasCancelled(false);
+    bool isDone = tilesToRender.empty();
+
+    for (size_t t = 0; t < tilesToRender.size(); ++t) {
+        _impl->pool.submit([&, t] {
+            const HitableCollection* world = version->worlds[ThreadPool::currentNode()].get();
+            if (!renderRegionTile(camera, world, region, tilesToRender[t], nbrOfSamples, pixels, viewKey,
+                                  cancelRequested)) {
+                wasCancelled = true;
+            }
+
+            if (--nbrOfRemainingTiles == 0) {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                isDone = true;
+                allTilesDone.notify_one();
+            }
+        }, nodeForTile(t, tilesToRender.size(), _impl->pool.topology().nbrOfNodes()));
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        allTilesDone.wait(lock, [&] { return isDone; });
+    }
+
+    if (wasCancelled) {
+        return RenderStatus::Cancelled;
+    }
+
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    _impl->cacheStatistics.nbrOfTilesRendered += tilesToRender.size();
+    _impl->cacheStatistics.nbrOfTilesReused += tiles.size() - tilesToRender.size();
+    if (_impl->renderCache.isEnabled()) {
+        std::shared_ptr<RenderCache::View> view(new RenderCache::View);
+        view->sceneHash = version->hash;
+        view->objects = version->objects;
+        view->pixels.assign(pixels, pixels + 3 * size_t(region.width) * region.height);
+        _impl->renderCache.store(viewKey, view);
+    }
+
+    return RenderStatus::Completed;
+}
+
+/**
+ * Sets up the render cache, dropping any views already cached.
+ * @param maxViews The number of views kept; 0 disables the cache.
+ * @param influenceRadius How far (in world units) from an edited object its changes are assumed
+ * to be visible on diffuse objects, through the light they bounce (2 by default).
+ * @param reflectionDistance How far (in world units, surface to surface) from an edited object a
+ * metal or glass sphere is assumed to show it; tiles that see such a sphere are re-rendered too
+ * (4 by default).
+ * Both are approximations, not bounds: larger is more exact but reuses fewer tiles, and FLT_MAX
+ * for both makes any edit re-render everything.
+ */
+void RenderEngine::configureRenderCache(uint maxViews, float influenceRadius, float reflectionDistance)
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    _impl->renderCache.configure(maxViews, influenceRadius, reflectionDistance);
+}
+
+/** Returns how many tiles have been rendered and how many were reused from the render cache. */
+RenderCacheStatistics RenderEngine::cacheStatistics() const
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    return _impl->cacheStatistics;
+}
+
+/** Returns the render throughput of each NUMA node's threads since the engine was created. */
+std::vector<NodeStatistics> RenderEngine::nodeStatistics() const
+{
+    return _impl->pool.nodeStatistics();
+}
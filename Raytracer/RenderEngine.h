@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "NumaTopology.h"
+#include "SceneDescription.h"
+#include "Vec3.h"
+
+/**
+ * Where a camera is and how its lens is set up. See Camera for what each setting does.
+ */
+struct CameraSettings
+{
+    Vec3 lookFrom;
+    Vec3 lookAt;
+    Vec3 up;
+    float vFov;
+    float aperture;
+    float focusDistance;
+};
+
+/**
+ * The part of an image to render: a width x height block of pixels, starting at pixel
+ * (startI, startJ), of an imageWidth x imageHeight image. As with the camera, pixel (0, 0) is the
+ * lower left corner of the image.
+ */
+struct RenderRegion
+{
+    uint imageWidth;
+    uint imageHeight;
+    uint startI;
+    uint startJ;
+    uint width;
+    uint height;
+};
+
+enum class RenderStatus { Completed, Cancelled };
+
+/**
+ * How much work the render cache has saved: tiles rendered versus tiles reused from earlier
+ * renders of the same view.
+ */
+struct RenderCacheStatistics
+{
+    unsigned long long nbrOfTilesRendered;
+    unsigned long long nbrOfTilesReused;
+};
+
+typedef uint SceneId;
+typedef uint ObjectId;
+
+/**
+ * An embeddable rendering engine. Scenes live inside the engine between renders, as do the worker
+ * threads and each scene's built world, so a caller can issue many small renders without paying
+ * for thread start up or scene construction each time. A scene's world is only rebuilt on the
+ * first render after it is edited.
+ *
+ * On NUMA machines each node's render threads are pinned to it and render from their own copy of
+ * the scene, and each node renders its own band of the region.
+ *
+ * Rendering is deterministic: the random numbers used for each tile are seeded from the view and
+ * the tile's position. That lets the engine keep a render cache of recent views. When a view is
+ * rendered again after the scene is edited, only the tiles that could see an edited object (as it
+ * was or as it is now), anything within the cache's influence radius of one, or a metal or glass
+ * sphere within its reflection distance of one (which could reflect the edit) are re-rendered; the
+ * rest are copied from the cache. Both distances are approximations, so surfaces further from an
+ * edit can be left slightly out of date.
+ *
+ * All member functions may be called from any thread. Editing a scene never waits for a render of
+ * it, nor for its world to be built; renders already running keep using the scene as it was when
+ * they started.
+ *
+ * Unknown scene and object ids throw std::invalid_argument.
+ */
+class RenderEngine final
+{
+public:
+    /**
+     * Creates a new RenderEngine.
+     * @param nbrOfThreads The number of render threads; 0 creates one per hardware thread.
+     */
+    explicit RenderEngine(uint nbrOfThreads = 0);
+
+    RenderEngine(const RenderEngine& rhs) = delete;
+    RenderEngine(RenderEngine&& rhs) = delete;
+    RenderEngine& operator=(const RenderEngine& rhs) = delete;
+    RenderEngine& operator=(RenderEngine&& rhs) = delete;
+
+    /**
+     * Stops the render threads. No render() may be running, or be called, while the engine is being
+     * destroyed; cancel running renders through their cancel flags and wait for them to return first.
+     */
+    ~RenderEngine();
+
+    /** Creates a new, empty scene. */
+    SceneId createScene();
+
+    /** Destroys a scene. Renders of it that are already running finish normally. */
+    void destroyScene(SceneId scene);
+
+    /** Adds a sphere to a scene, returning its id within the scene. */
+    ObjectId addSphere(SceneId scene, const SphereDescription& sphere);
+
+    /** Replaces a sphere in a scene (e.g., to move it or change its material). */
+    void updateSphere(SceneId scene, ObjectId object, const SphereDescription& sphere);
+
+    /** Removes an object from a scene. */
+    void removeObject(SceneId scene, ObjectId object);
+
+    /**
+     * Renders a region of a scene, blocking until it is done or cancelled.
+     * @param pixels Caller provided buffer of region.width * region.height pixels, each three floats
+     * (red, green, blue). Rows are stored top row first. Colors are the linear (not gamma
+     * corrected) average of the pixel's samples. If the render is cancelled, pixels that were not
+     * rendered are left untouched.
+     * @param cancelRequested Optional cancel flag for this render only. Setting it (from any thread)
+     * makes the render return RenderStatus::Cancelled as soon as the rows it is working on are
+     * finished. Other renders are not affected.
+     */
+    RenderStatus render(SceneId scene, const CameraSettings& camera, const RenderRegion& region,
+                        uint nbrOfSamples, float* pixels, const std::atomic<bool>* cancelRequested = nullptr);
+
+    /**
+     * Sets up the render cache, dropping any views already cached.
+     * @param maxViews The number of views kept; 0 disables the cache.
+     * @param influenceRadius How far (in world units) from an edited object its changes are assumed
+     * to be visible on diffuse objects, through the light they bounce (2 by default).
+     * @param reflectionDistance How far (in world units, surface to surface) from an edited object a
+     * metal or glass sphere is assumed to show it; tiles that see such a sphere are re-rendered too
+     * (4 by default).
+     * Both are approximations, not bounds: larger is more exact but reuses fewer tiles, and FLT_MAX
+     * for both makes any edit re-render everything.
+     */
+    void configureRenderCache(uint maxViews, float influenceRadius, float reflectionDistance);
+
+    /** Returns how many tiles have been rendered and how many were reused from the render cache. */
+    RenderCacheStatistics cacheStatistics() const;
+
+    /** Returns the render throughput of each NUMA node's threads since the engine was created. */
+    std::vector<NodeStatistics> nodeStatistics() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> _impl;
+};
@@ -0,0 +1,93 @@
+#include "SceneDescription.h"
+
+#include "Hash.h"
+#include "HitableCollection.h"
+#include "Material.h"
+#include "NumaTopology.h"
+#include "Sphere.h"
+
+MaterialDescription MaterialDescription::lambertian(const Vec3& albedo)
+{
+    return MaterialDescription{Type::Lambertian, albedo, 0.0f, 1.0f};
+}
+
+MaterialDescription MaterialDescription::metal(const Vec3& albedo, float bluriness)
+{
+    return MaterialDescription{Type::Metal, albedo, bluriness, 1.0f};
+}
+
+MaterialDescription MaterialDescription::dielectric(float refractiveIndex)
+{
+    return MaterialDescription{Type::Dielectric, Vec3(1.0f, 1.0f, 1.0f), 0.0f, refractiveIndex};
+}
+
+/** Returns a hash of everything that describes the sphere. */
+uint64_t hashSphere(const SphereDescription& sphere)
+{
+    const MaterialDescription& material = sphere.material;
+
+    uint64_t hash = hashCombine(uint64_t(0), uint64_t(material.type));
+    for (int k = 0; k < 3; ++k) {
+        hash = hashCombine(hash, sphere.center[k]);
+        hash = hashCombine(hash, material.albedo[k]);
+    }
+    hash = hashCombine(hash, sphere.radius);
+    hash = hashCombine(hash, material.bluriness);
+    return hashCombine(hash, material.refractiveIndex);
+}
+
+/** Creates the Material described; the caller takes ownership of it. */
+Material* createMaterial(const MaterialDescription& description)
+{
+    switch (description.type) {
+        case MaterialDescription::Type::Lambertian:
+            return new Lambertian(description.albedo);
+        case MaterialDescription::Type::Metal:
+            return new Metal(description.albedo, description.bluriness);
+        case MaterialDescription::Type::Dielectric:
+            return new Dielectric(description.refractiveIndex);
+    }
+    return nullptr;
+}
+
+/**
+ * Scatters a ray off the described material, as Material::scatter() does, without creating a
+ * Material object.
+ */
+bool scatter(const MaterialDescription& description, const Ray& r_in, const HitableProperties& properties,
+             Ray& scatteredRay, Vec3& rayAttenuation)
+{
+    switch (description.type) {
+        case MaterialDescription::Type::Lambertian:
+            return Lambertian(description.albedo).scatter(r_in, properties, scatteredRay, rayAttenuation);
+        case MaterialDescription::Type::Metal:
+            return Metal(description.albedo, description.bluriness).scatter(r_in, properties, scatteredRay, rayAttenuation);
+        case MaterialDescription::Type::Dielectric:
+            return Dielectric(description.refractiveIndex).scatter(r_in, properties, scatteredRay, rayAttenuation);
+    }
+    return false;
+}
+
+/** Creates a world containing the described spheres; the caller takes ownership of it. */
+HitableCollection* buildWorld(const std::vector<SphereDescription>& spheres)
+{
+    HitableCollection* world = new HitableCollection();
+    for (const auto& sphere : spheres) {
+        world->add(new Sphere(sphere.center, sphere.radius, createMaterial(sphere.material)));
+    }
+    return world;
+}
+
+/**
+ * Builds one copy of the world per NUMA node, each built by a thread on its node so that its
+ * memory is local to that node. The result is indexed by node.
+ */
+std::vector<std::shared_ptr<const HitableCollection>> buildNodeLocalWorlds(
+        const NumaTopology& topology, const std::vector<SphereDescription>& spheres)
+{
+    std::vector<std::shared_ptr<const HitableCollection>> worlds(topology.nbrOfNodes());
+    topology.runOnEachNode([&](uint node) {
+        worlds[node].reset(buildWorld(spheres));
+    });
+    return worlds;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Vec3.h"
+
+class HitableCollection;
+class Material;
+class Ray;
+struct HitableProperties;
+class NumaTopology;
+
+/**
+ * Describes a material by value (rather than as a Material object), so that scenes can be copied,
+ * edited, and rebuilt.
+ */
+struct MaterialDescription
+{
+    enum class Type { Lambertian, Metal, Dielectric };
+
+    Type type;
+    Vec3 albedo;            // Lambertian and Metal
+    float bluriness;        // Metal
+    float refractiveIndex;  // Dielectric
+
+    static MaterialDescription lambertian(const Vec3& albedo);
+    static MaterialDescription metal(const Vec3& albedo, float bluriness);
+    static MaterialDescription dielectric(float refractiveIndex);
+};
+
+/**
+ * Describes a sphere by value.
+ */
+struct SphereDescription
+{
+    Vec3 center;
+    float radius;
+    MaterialDescription material;
+};
+
+/** Returns a hash of everything that describes the sphere. */
+uint64_t hashSphere(const SphereDescription& sphere);
+
+/** Creates the Material described; the caller takes ownership of it. */
+Material* createMaterial(const MaterialDescription& description);
+
+/**
+ * Scatters a ray off the described material, as Material::scatter() does, without creating a
+ * Material object.
+ */
+bool scatter(const MaterialDescription& description, const Ray& r_in, const HitableProperties& properties,
+             Ray& scatteredRay, Vec3& rayAttenuation);
+
+/** Creates a world containing the described spheres; the caller takes ownership of it. */
+HitableCollection* buildWorld(const std::vector<SphereDescription>& spheres);
+
+/**
+ * Builds one copy of the world per NUMA node, each built by a thread on its node so that its
+ * memory is local to that node. The result is indexed by node.
+ */
+std::vector<std::shared_ptr<const HitableCollection>> buildNodeLocalWorlds(
+        const NumaTopology& topology, const std::vector<SphereDescription>& spheres);
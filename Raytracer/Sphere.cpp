@@ -81,6 +81,13 @@ bool Sphere::hit(const Ray& r, float t_min, float t_max, HitableProperties& prop
     return didHit;
 }
 
+/** Sets center and radius to a sphere that encloses this object. */
+void Sphere::boundingSphere(Vec3& center, float& radius) const
+{
+    center = _center;
+    radius = _radius;
+}
+
 bool Sphere::hit(const Ray& r, float t_min, float t_max, HitableProperties& properties, float t) const
 {
     if (t < t_max && t > t_min) {
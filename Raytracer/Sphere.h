@@ -22,6 +22,9 @@ public:
      */
     bool hit(const Ray& r, float t_min, float t_max, HitableProperties& properties) const override;
 
+    /** Sets center and radius to a sphere that encloses this object. */
+    void boundingSphere(Vec3& center, float& radius) const override;
+
 private:
     Vec3 _center;
     float _radius;
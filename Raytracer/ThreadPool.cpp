@@ -0,0 +1,183 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+
+// parallelFor() makes a few slices per thread, so slices that take longer than others don't leave
+// threads idle.
+const size_t SLICES_PER_THREAD = 4;
+
+namespace {
+
+thread_local uint currentPoolNode = 0;
+thread_local unsigned long long nbrOfSamplesCounted = 0;    // by the current task
+
+}
+
+/**
+ * Creates a new ThreadPool.
+ * @param nbrOfThreads The number of worker threads; 0 creates one per hardware thread.
+ */
+ThreadPool::ThreadPool(uint nbrOfThreads)
+        : _topology(NumaTopology::detect()),
+          _nbrOfUnfinishedTasks(0),
+          _isStopping(false)
+{
+    if (nbrOfThreads == 0) {
+        nbrOfThreads = _topology.nbrOfCpus();
+    }
+
+    const uint nbrOfNodes = _topology.nbrOfNodes();
+    _tasks.resize(nbrOfNodes + 1);
+    _nodeStatistics.resize(nbrOfNodes, NodeStatistics{0, 0, 0, 0.0});
+
+    // Give each node a share of the threads proportional to its share of the CPUs.
+    uint nbrOfCpusSoFar = 0;
+    for (uint node = 0; node < nbrOfNodes; ++node) {
+        uint firstThread = nbrOfThreads * nbrOfCpusSoFar / _topology.nbrOfCpus();
+        nbrOfCpusSoFar += uint(_topology.cpus(node).size());
+        uint endThread = nbrOfThreads * nbrOfCpusSoFar / _topology.nbrOfCpus();
+
+        for (uint t = firstThread; t < endThread; ++t) {
+            _workers.emplace_back(&ThreadPool::runTasks, this, node);
+        }
+        _nodeStatistics[node].nbrOfThreads = endThread - firstThread;
+    }
+}
+
+/** Finishes any tasks still queued, then stops the worker threads. */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _taskAvailable.notify_all();
+
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+/** Queues a task to be run by the next free worker thread. */
+void ThreadPool::submit(std::function<void()> task)
+{
+    submit(std::move(task), _topology.nbrOfNodes());
+}
+
+/** Queues a task to be run, preferably, by a worker thread on the supplied NUMA node. */
+void ThreadPool::submit(std::function<void()> task, uint node)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks[std::min(node, _topology.nbrOfNodes())].push_back(std::move(task));
+        _nbrOfUnfinishedTasks++;
+    }
+    _taskAvailable.notify_one();
+}
+
+/** Blocks until every task submitted so far has finished running. */
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _allTasksDone.wait(lock, [this] { return _nbrOfUnfinishedTasks == 0; });
+}
+
+/** Returns the number of slices parallelFor() splits [0, n) into. */
+size_t ThreadPool::nbrOfSlices(size_t n) const
+{
+    return std::min(n, size_t(size()) * SLICES_PER_THREAD);
+}
+
+/**
+ * Splits [0, n) into nbrOfSlices(n) contiguous slices, runs body(slice, begin, end) for each on
+ * the workers, and waits for them (and anything else submitted) to finish.
+ */
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t slice, size_t begin, size_t end)>& body)
+{
+    size_t slices = nbrOfSlices(n);
+    for (size_t slice = 0; slice < slices; ++slice) {
+        size_t begin = n * slice / slices;
+        size_t end = n * (slice + 1) / slices;
+        submit([&body, slice, begin, end] { body(slice, begin, end); });
+    }
+    wait();
+}
+
+/** Returns the throughput of each node's workers since the pool was created. */
+std::vector<NodeStatistics> ThreadPool::nodeStatistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _nodeStatistics;
+}
+
+/** Returns the NUMA node of the calling worker thread (0 if not called from a worker thread). */
+uint ThreadPool::currentNode()
+{
+    return currentPoolNode;
+}
+
+/** Credits samples rendered by the calling worker thread to its node's statistics. */
+void ThreadPool::countSamples(unsigned long long nbrOfSamples)
+{
+    nbrOfSamplesCounted += nbrOfSamples;
+}
+
+// Takes the next task for a worker on the supplied node: its own node's tasks first, then tasks for
+// any node, and finally tasks queued for other nodes. Must be called with the mutex held.
+bool ThreadPool::takeTask(uint node, std::function<void()>& task)
+{
+    auto takeFrom = [&task](std::deque<std::function<void()>>& queue) {
+        if (queue.empty()) {
+            return false;
+        }
+        task = std::move(queue.front());
+        queue.pop_front();
+        return true;
+    };
+
+    const uint nbrOfNodes = _topology.nbrOfNodes();
+    if (takeFrom(_tasks[node]) || takeFrom(_tasks[nbrOfNodes])) {
+        return true;
+    }
+    for (uint offset = 1; offset < nbrOfNodes; ++offset) {
+        if (takeFrom(_tasks[(node + offset) % nbrOfNodes])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Worker thread loop: runs queued tasks until the pool is stopping and the queues are empty.
+void ThreadPool::runTasks(uint node)
+{
+    _topology.pinCurrentThread(node);
+    currentPoolNode = node;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true) {
+        std::function<void()> task;
+        _taskAvailable.wait(lock, [&] { return takeTask(node, task) || _isStopping; });
+        if (!task) {
+            return;     // stopping, and nothing left to do
+        }
+
+        lock.unlock();
+        auto beginTime = std::chrono::steady_clock::now();
+        nbrOfSamplesCounted = 0;
+        task();
+        double taskSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - beginTime).count();
+        lock.lock();
+
+        NodeStatistics& statistics = _nodeStatistics[node];
+        statistics.nbrOfTasks++;
+        statistics.nbrOfSamples += nbrOfSamplesCounted;
+        statistics.busySeconds += taskSeconds;
+
+        if (--_nbrOfUnfinishedTasks == 0) {
+            _allTasksDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "NumaTopology.h"
+
+/**
+ * A fixed set of worker threads that run submitted tasks. Tasks are started in the order they were
+ * submitted within each queue (one per node, plus one for any node), but there is no order between
+ * queues, and with several workers tasks can finish in any order.
+ *
+ * On NUMA machines the workers are spread over the nodes in proportion to their CPUs and pinned
+ * there. A task can be submitted to a particular node; that node's workers run it unless they fall
+ * behind, in which case idle workers on other nodes take it over. Tasks can ask which node they
+ * are running on with currentNode() and use that node's copy of any data they read.
+ */
+class ThreadPool final
+{
+public:
+    /**
+     * Creates a new ThreadPool.
+     * @param nbrOfThreads The number of worker threads; 0 creates one per hardware thread.
+     */
+    explicit ThreadPool(uint nbrOfThreads = 0);
+
+    ThreadPool(const ThreadPool& rhs) = delete;
+    ThreadPool(ThreadPool&& rhs) = delete;
+    ThreadPool& operator=(const ThreadPool& rhs) = delete;
+    ThreadPool& operator=(ThreadPool&& rhs) = delete;
+
+    /** Finishes any tasks still queued, then stops the worker threads. */
+    ~ThreadPool();
+
+    /** Returns the number of worker threads. */
+    uint size() const { return uint(_workers.size()); }
+
+    /** Returns the NUMA topology the workers are spread over. */
+    const NumaTopology& topology() const { return _topology; }
+
+    /** Queues a task to be run by the next free worker thread. */
+    void submit(std::function<void()> task);
+
+    /** Queues a task to be run, preferably, by a worker thread on the supplied NUMA node. */
+    void submit(std::function<void()> task, uint node);
+
+    /** Blocks until every task submitted so far has finished running. */
+    void wait();
+
+    /** Returns the number of slices parallelFor() splits [0, n) into. */
+    size_t nbrOfSlices(size_t n) const;
+
+    /**
+     * Splits [0, n) into nbrOfSlices(n) contiguous slices, runs body(slice, begin, end) for each on
+     * the workers, and waits for them (and anything else submitted) to finish.
+     */
+    void parallelFor(size_t n, const std::function<void(size_t slice, size_t begin, size_t end)>& body);
+
+    /** Returns the throughput of each node's workers since the pool was created. */
+    std::vector<NodeStatistics> nodeStatistics() const;
+
+    /** Returns the NUMA node of the calling worker thread (0 if not called from a worker thread). */
+    static uint currentNode();
+
+    /** Credits samples rendered by the calling worker thread to its node's statistics. */
+    static void countSamples(unsigned long long nbrOfSamples);
+
+private:
+    NumaTopology _topology;
+    std::vector<std::thread> _workers;
+    std::vector<std::deque<std::function<void()>>> _tasks;     // one queue per node, then one for any node
+    mutable std::mutex _mutex;
+    std::condition_variable _taskAvailable;
+    std::condition_variable _allTasksDone;
+    uint _nbrOfUnfinishedTasks;     // queued plus running
+    bool _isStopping;
+    std::vector<NodeStatistics> _nodeStatistics;
+
+    void runTasks(uint node);
+    bool takeTask(uint node, std::function<void()>& task);
+};
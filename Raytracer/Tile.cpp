@@ -0,0 +1,46 @@
+#include "Tile.h"
+
+#include <algorithm>
+
+#include "PrimaryRays.h"
+#include "ThreadPool.h"
+
+/**
+ * Splits an image into tiles of at most tileSize x tileSize pixels, top row of tiles first (the
+ * order the image is written in).
+ */
+std::vector<Tile> splitIntoTiles(uint imageWidth, uint imageHeight, uint tileSize)
+{
+    std::vector<Tile> tiles;
+
+    uint nbrOfTileRows = (imageHeight + tileSize - 1) / tileSize;
+    for (int tileRow = nbrOfTileRows - 1; tileRow >= 0; --tileRow) {
+        for (uint startI = 0; startI < imageWidth; startI += tileSize) {
+            uint startJ = tileRow * tileSize;
+            tiles.push_back(Tile{startI, startJ,
+                                 std::min(startI + tileSize, imageWidth),
+                                 std::min(startJ + tileSize, imageHeight)});
+        }
+    }
+
+    return tiles;
+}
+
+/** Adds nbrOfSamples samples to every pixel of the tile. */
+void renderTile(const Camera& camera, const HitableCollection* world, FrameBuffer& frameBuffer,
+                const Tile& tile, uint nbrOfSamples)
+{
+    PrimaryRays primaryRays(camera, world, tile, frameBuffer.width(), frameBuffer.height());
+    std::vector<Vec3> samples;
+
+    for (uint j = tile.startJ; j < tile.endJ; ++j) {
+        primaryRays.traceRow(j, nbrOfSamples, samples);
+        for (uint i = tile.startI; i < tile.endI; ++i) {
+            for (uint s = 0; s < nbrOfSamples; ++s) {
+                frameBuffer.addSample(i, j, samples[(i - tile.startI) * nbrOfSamples + s]);
+            }
+        }
+    }
+
+    ThreadPool::countSamples((unsigned long long)(tile.endI - tile.startI) * (tile.endJ - tile.startJ) * nbrOfSamples);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "Camera.h"
+#include "FrameBuffer.h"
+#include "HitableCollection.h"
+
+/**
+ * A rectangular block of pixels, [startI, endI) x [startJ, endJ). Tiles are the unit of work
+ * handed to render threads; tiles never overlap, so threads can render them into the same
+ * FrameBuffer at the same time.
+ */
+struct Tile
+{
+    uint startI;
+    uint startJ;
+    uint endI;
+    uint endJ;
+};
+
+/** Square tile size (in pixels) used when splitting an image up between render threads. */
+const uint TILE_SIZE = 32;
+
+/**
+ * Splits an image into tiles of at most tileSize x tileSize pixels, top row of tiles first (the
+ * order the image is written in).
+ */
+std::vector<Tile> splitIntoTiles(uint imageWidth, uint imageHeight, uint tileSize = TILE_SIZE);
+
+/**
+ * Returns the NUMA node that tile number tileIndex (of nbrOfTiles) should preferably be rendered
+ * on. Tiles are handed out in contiguous bands, so each node writes its own block of rows.
+ */
+inline uint nodeForTile(size_t tileIndex, size_t nbrOfTiles, uint nbrOfNodes)
+{
+    return uint(tileIndex * nbrOfNodes / nbrOfTiles);
+}
+
+/** Adds nbrOfSamples samples to every pixel of the tile. */
+void renderTile(const Camera& camera, const HitableCollection* world, FrameBuffer& frameBuffer,
+                const Tile& tile, uint nbrOfSamples);
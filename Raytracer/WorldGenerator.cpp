@@ -0,0 +1,151 @@
+#include "WorldGenerator.h"
+
+#include "Hash.h"
+
+const float SMALL_SPHERE_RADIUS = 0.2f;
+const float SMALL_SPHERE_SPREAD = 0.9f;     // how far into its cell a small sphere's center can be
+const float MIN_GAP = 0.05f;                // between a small sphere and any other sphere
+const uint MAX_ATTEMPTS_PER_CELL = 4;
+
+namespace {
+
+// Draws a cell's random numbers. Each number is a hash of the seed, the cell, and how many numbers
+// the cell has drawn so far, so cells can be generated in any order, on any thread.
+class CellRandom final
+{
+public:
+    CellRandom(uint64_t seed, int x, int y)
+            : _hash(hashCombine(hashCombine(seed, uint64_t(int64_t(x))), uint64_t(int64_t(y)))),
+              _counter(0)
+    { }
+
+    // Returns the next random number in [0, 1).
+    float next()
+    {
+        uint64_t bits = hashCombine(_hash, _counter++);
+        return float(bits >> 40) / float(1 << 24);
+    }
+
+private:
+    uint64_t _hash;
+    uint64_t _counter;
+};
+
+}
+
+// Picks a small sphere's material: mostly diffuse, some metal, and a little glass.
+static MaterialDescription randomMaterial(CellRandom& random)
+{
+    float materialType = random.next();
+    if (materialType < 0.8f) {
+        float r = random.next() * random.next();
+        float g = random.next() * random.next();
+        float b = random.next() * random.next();
+        return MaterialDescription::lambertian(Vec3(r, g, b));
+    }
+    else if (materialType < 0.95f) {
+        float r = random.next();
+        float g = random.next();
+        float b = random.next();
+        float bluriness = random.next();
+        return MaterialDescription::metal(Vec3(0.5f * (1.0f + r), 0.5f * (1.0f + g), 0.5f * (1.0f + b)),
+                                          0.5f * bluriness);
+    }
+    else {
+        return MaterialDescription::dielectric(1.5f);
+    }
+}
+
+/**
+ * Generates a world of spheres with different material properties: diffuse ("normal"), metal, and
+ * glass. A ground sphere and three big spheres are surrounded by small spheres, at most one per cell
+ * of a gridSize x gridSize grid of unit cells centered on the origin.
+ *
+ * Cells are generated in parallel. Each cell draws its random numbers from a hash of the seed, the
+ * cell, and a counter rather than from a shared generator, and cells are generated in four phases
+ * (by the parity of their coordinates) so that neighboring cells never run at the same time; the
+ * same seed and grid size therefore always give the same world, whatever the number of threads.
+ * Small spheres never overlap each other or the big spheres: a candidate too close to a sphere
+ * already placed in a neighboring cell is rejected and another one tried, and a cell with no
+ * acceptable candidate is left empty.
+ *
+ * The spheres are written straight into the returned vector, the ground first, then the small
+ * spheres cell by cell, then the big spheres.
+ */
+std::vector<SphereDescription> generateRandomWorld(uint gridSize, uint64_t seed, ThreadPool& pool)
+{
+    const std::vector<SphereDescription> bigSpheres = {
+        {Vec3(0.0f, 1.0f, 0.0f), 1.0f, MaterialDescription::dielectric(1.5f)},
+        {Vec3(-4.0f, 1.0f, 0.0f), 1.0f, MaterialDescription::lambertian(Vec3(0.4f, 0.2f, 0.1f))},
+        {Vec3(4.0f, 1.0f, 0.0f), 1.0f, MaterialDescription::metal(Vec3(0.7f, 0.6f, 0.5f), 0.0f)}
+    };
+    const int firstIndex = -int(gridSize / 2);
+    const size_t nbrOfCells = size_t(gridSize) * gridSize;
+
+    // Slot 0 holds the ground, and slot 1 + cell the cell's small sphere; the grid of slots is the
+    // spatial hash the spacing checks look neighbors up in. Empty slots are squeezed out at the end.
+    std::vector<SphereDescription> world(1 + nbrOfCells);
+    std::vector<char> isOccupied(nbrOfCells, 0);
+    world[0] = {Vec3(0.0f, -1000.0f, 0.0f), 1000.0f, MaterialDescription::lambertian(Vec3(0.5f, 0.5f, 0.5f))};
+
+    // Returns true if a small sphere at center would be clear of the big spheres and of the small
+    // spheres placed so far in the cells around cell (a, b).
+    auto isClear = [&](const Vec3& center, uint a, uint b) {
+        for (const SphereDescription& big : bigSpheres) {
+            if ((center - big.center).length() < big.radius + SMALL_SPHERE_RADIUS + MIN_GAP) {
+                return false;
+            }
+        }
+        for (uint na = (a > 0 ? a - 1 : a); na <= a + 1 && na < gridSize; ++na) {
+            for (uint nb = (b > 0 ? b - 1 : b); nb <= b + 1 && nb < gridSize; ++nb) {
+                size_t neighbor = size_t(na) * gridSize + nb;
+                if (isOccupied[neighbor] &&
+                        (center - world[1 + neighbor].center).length() < 2.0f * SMALL_SPHERE_RADIUS + MIN_GAP) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    // Cells whose coordinates have the same parities are at least two cells apart, so a phase's
+    // cells only look at cells placed in earlier phases.
+    for (uint phase = 0; phase < 4; ++phase) {
+        uint aParity = phase % 2;
+        uint bParity = phase / 2;
+        size_t nbrOfColumns = (gridSize + 1 - aParity) / 2;
+
+        pool.parallelFor(nbrOfColumns, [&](size_t, size_t begin, size_t end) {
+            for (size_t column = begin; column < end; ++column) {
+                uint a = uint(2 * column + aParity);
+                for (uint b = bParity; b < gridSize; b += 2) {
+                    int x = firstIndex + int(a);
+                    int y = firstIndex + int(b);
+                    CellRandom random(seed, x, y);
+
+                    for (uint attempt = 0; attempt < MAX_ATTEMPTS_PER_CELL; ++attempt) {
+                        Vec3 center(x + SMALL_SPHERE_SPREAD * random.next(), SMALL_SPHERE_RADIUS,
+                                    y + SMALL_SPHERE_SPREAD * random.next());
+                        if (isClear(center, a, b)) {
+                            size_t cell = size_t(a) * gridSize + b;
+                            world[1 + cell] = {center, SMALL_SPHERE_RADIUS, randomMaterial(random)};
+                            isOccupied[cell] = 1;
+                            break;
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    size_t nbrOfSpheres = 1;
+    for (size_t cell = 0; cell < nbrOfCells; ++cell) {
+        if (isOccupied[cell]) {
+            world[nbrOfSpheres++] = world[1 + cell];
+        }
+    }
+    world.resize(nbrOfSpheres);
+    world.insert(world.end(), bigSpheres.begin(), bigSpheres.end());
+
+    return world;
+}
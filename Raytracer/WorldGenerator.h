@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "SceneDescription.h"
+#include "ThreadPool.h"
+
+/**
+ * Generates a world of spheres with different material properties: diffuse ("normal"), metal, and
+ * glass. A ground sphere and three big spheres are surrounded by small spheres, at most one per cell
+ * of a gridSize x gridSize grid of unit cells centered on the origin.
+ *
+ * Cells are generated in parallel. Each cell draws its random numbers from a hash of the seed, the
+ * cell, and a counter rather than from a shared generator, and cells are generated in four phases
+ * (by the parity of their coordinates) so that neighboring cells never run at the same time; the
+ * same seed and grid size therefore always give the same world, whatever the number of threads.
+ * Small spheres never overlap each other or the big spheres: a candidate too close to a sphere
+ * already placed in a neighboring cell is rejected and another one tried, and a cell with no
+ * acceptable candidate is left empty.
+ *
+ * The spheres are written straight into the returned vector, the ground first, then the small
+ * spheres cell by cell, then the big spheres.
+ */
+std::vector<SphereDescription> generateRandomWorld(uint gridSize, uint64_t seed, ThreadPool& pool);
@@ -20,109 +20,379 @@
  * Created by John Koszarek on 7/2/18.
  */
 
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <cfloat>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <random>
+#include <stdexcept>
+#include <string>
 
+#include "BatchRenderer.h"
 #include "Camera.h"
+#include "ChunkedScene.h"
+#include "FrameBuffer.h"
 #include "HitableObject.h"
 #include "HitableCollection.h"
-#include "Material.h"
+#include "ImageWriter.h"
+#include "Integrator.h"
+#include "OutOfCoreRenderer.h"
+#include "PrimaryRays.h"
 #include "Ray.h"
-#include "Sphere.h"
+#include "SceneDescription.h"
+#include "ThreadPool.h"
 #include "Vec3.h"
+#include "WorldGenerator.h"
 
 const char* IMAGE_PATH = "/Users/john/Dev/Raytracing/Raytracer/image.ppm";
 
-const Vec3 BLACK(0.0f, 0.0f, 0.0f);
-const Vec3 BLUE(0.5f, 0.7f, 1.0f);
-const Vec3 WHITE(1.0f, 1.0f, 1.0f);
+// Time-budgeted rendering: passes alternate between one sample for every pixel and extra samples
+// for the pixels whose averages are least certain. Some time is held back for writing the image.
+const uint ADAPTIVE_SAMPLES_PER_PASS = 2;
+const uint FIRST_PASS_SAMPLES = 2;     // enough for every pixel to have a standard error
+const double FINALIZE_RESERVE_SECONDS = 0.1;
+const double MAX_TIME_BUDGET_SECONDS = 365.0 * 24.0 * 60.0 * 60.0;    // keeps the deadline representable
+const uint REPORT_REGION_SIZE = 200;   // pixels; the image is split into squares this size for the spp report
+const uint COARSEST_ROW_STRIDE = 16;   // full passes render every 16th row first, then fill in between
 
-std::random_device rndNbrGenerator;
-std::default_random_engine rndNbrEngine(rndNbrGenerator());
-std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+// Rendered rows waiting to be written are bounded by this many per render thread.
+const uint ROWS_IN_FLIGHT_PER_THREAD = 4;
 
-Vec3 calculateColor(const Ray &r, HitableCollection* world, int depth)
+// Out-of-core rendering: the world is written out in chunks of at most this many spheres (see
+// writeChunkedScene()), and the chunks are paged in within a memory budget while rendering.
+const uint SPHERES_PER_CHUNK = 1024;
+const double DEFAULT_MEMORY_BUDGET_MB = 64.0;
+const double MAX_MEMORY_BUDGET_MB = 1024.0 * 1024.0;
+
+// The world's small spheres are placed on a grid this many cells across (see generateRandomWorld()).
+// The largest world, 10000 cells across, holds up to 100 million spheres (about 5 GB).
+const uint DEFAULT_WORLD_SIZE = 5;     // 22
+const uint MAX_WORLD_SIZE = 10000;
+
+// Parses a command line option's value as a number in [minValue, maxValue]. Returns false if the
+// text isn't a number, has anything after it, or is out of range.
+bool parseNumber(const char* text, double minValue, double maxValue, double& value)
 {
-    HitableProperties properties;
+    char* end = nullptr;
+    errno = 0;
+    double parsed = strtod(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !(parsed >= minValue && parsed <= maxValue)) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+// Parses a command line option's value as a whole number in [minValue, maxValue]. Returns false if
+// the text isn't a whole number (a sign isn't allowed), has anything after it, or is out of range.
+bool parseWholeNumber(const char* text, uint64_t minValue, uint64_t maxValue, uint64_t& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if (!isdigit(static_cast<unsigned char>(text[0])) || *end != '\0' || errno == ERANGE ||
+            parsed < minValue || parsed > maxValue) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
 
-    if (world->hit(r, 0.00001, FLT_MAX, properties)) {
-        Ray scatteredRay;
-        Vec3 rayAttenuation;
+// Returns the average standard error of the pixels that have enough samples to have one.
+float averageStandardError(const FrameBuffer& frameBuffer)
+{
+    double errorSum = 0.0;
+    uint nbrOfPixels = 0;
 
-        if (depth < 50 && properties.material->scatter(r, properties, scatteredRay, rayAttenuation)) {
-            return rayAttenuation * calculateColor(scatteredRay, world, depth + 1);
-        }
-        else {
-            return BLACK;
+    for (uint j = 0; j < frameBuffer.height(); ++j) {
+        for (uint i = 0; i < frameBuffer.width(); ++i) {
+            float error = frameBuffer.standardError(i, j);
+            if (error != std::numeric_limits<float>::infinity()) {
+                errorSum += error;
+                nbrOfPixels++;
+            }
         }
     }
-    else {  // blended_value = (1 - t) * start_value + t * end_value; t goes from 0 to 1
-        Vec3 unitDirection = Vec3::unitVector(r.direction());
-        float t = 0.5 * (unitDirection.y() + 1.0);
-        Vec3 blendedColorValue = ((1.0 - t) * WHITE) + (t * BLUE);
-        return blendedColorValue;
+
+    return nbrOfPixels > 0 ? float(errorSum / nbrOfPixels) : 0.0f;
+}
+
+// Returns the rows of an image in coarse to fine order: every COARSEST_ROW_STRIDE-th row from the
+// top, then the rows halfway between those, and so on, so that a pass cut short still covers the
+// whole image.
+std::vector<uint> coarseToFineRows(uint imageHeight)
+{
+    std::vector<uint> rows;
+    std::vector<bool> isListed(imageHeight, false);
+
+    for (uint stride = COARSEST_ROW_STRIDE; stride >= 1; stride /= 2) {
+        for (uint row = 0; row < imageHeight; row += stride) {
+            if (!isListed[row]) {
+                isListed[row] = true;
+                rows.push_back(imageHeight - 1 - row);
+            }
+        }
     }
+
+    return rows;
 }
 
-// Creates a world of spheres with different material properties: diffuse ("normal"), metal, and
-// glass.
-void populateRandomWorld(HitableCollection* const world)
+// Keeps adding sample passes across all pixels until the deadline. Even passes take one sample for
+// every pixel (two in the first pass, so that every pixel has a standard error for the adaptive
+// passes to compare); odd passes only sample the pixels whose standard error is above average (the
+// noisy ones). Rows are rendered on the thread pool in coarse to fine order, and a row that hasn't
+// started by the deadline is skipped, so at most one row per thread runs past it. The first pass's
+// coarsest rows are always rendered, however late it is, so the image is never left empty.
+// Returns the number of passes started.
+uint renderWithinTimeBudget(const Camera& camera, const std::vector<std::shared_ptr<const HitableCollection>>& worlds,
+                            FrameBuffer& frameBuffer, std::chrono::steady_clock::time_point deadline,
+                            ThreadPool& pool)
 {
-    const int START_X_INDEX = -2;   // -11;
-    const int END_X_INDEX = 2;      // 10
-    const int START_Y_INDEX = -2;   // -11;
-    const int END_Y_INDEX = 2;      // 10
-
-    world->add(new Sphere(Vec3(0.0f, -1000.0f, 0.0f), 1000.0f, new Lambertian(Vec3(0.5f, 0.5f, 0.5f))));
-
-    for (int x = START_X_INDEX; x <= END_X_INDEX; x++) {
-        for (int y = START_Y_INDEX; y <= END_Y_INDEX; y++) {
-            Vec3 center(x + 0.9f * distribution(rndNbrEngine), 0.2f, y + 0.9f * distribution(rndNbrEngine));
-            if ((center - Vec3(4.0f, 0.2f, 0.0f)).length() > 0.9f) {
-                float materialType = distribution(rndNbrEngine);
-                if (materialType < 0.8f) {
-                    //std::cout << "Adding diffuse sphere" << std::endl;
-                    float r = distribution(rndNbrEngine) * distribution(rndNbrEngine);
-                    float g = distribution(rndNbrEngine) * distribution(rndNbrEngine);
-                    float b = distribution(rndNbrEngine) * distribution(rndNbrEngine);
-                    world->add(new Sphere(center, 0.2f, new Lambertian(Vec3(r, g, b))));
+    const uint imageWidth = frameBuffer.width();
+    const uint imageHeight = frameBuffer.height();
+    const std::vector<uint> rows = coarseToFineRows(imageHeight);
+    const size_t nbrOfCoarsestRows = (imageHeight + COARSEST_ROW_STRIDE - 1) / COARSEST_ROW_STRIDE;
+
+    uint pass = 0;
+    while (pass == 0 || std::chrono::steady_clock::now() < deadline) {
+        bool isAdaptivePass = (pass % 2 == 1);
+        uint nbrOfUniformSamples = (pass == 0) ? FIRST_PASS_SAMPLES : 1;
+        float errorThreshold = isAdaptivePass ? averageStandardError(frameBuffer) : 0.0f;
+
+        for (size_t r = 0; r < rows.size(); ++r) {
+            bool isRequired = (pass == 0 && r < nbrOfCoarsestRows);
+            uint j = rows[r];
+            pool.submit([&, j, isAdaptivePass, nbrOfUniformSamples, errorThreshold, isRequired] {
+                if (!isRequired && std::chrono::steady_clock::now() >= deadline) {
+                    return;
                 }
-                else if (materialType < 0.95f) {
-                    //std::cout << "Adding metal sphere" << std::endl;
-                    float r = distribution(rndNbrEngine);
-                    float g = distribution(rndNbrEngine);
-                    float b = distribution(rndNbrEngine);
-                    float bluriness = distribution(rndNbrEngine);
-                    world->add(new Sphere(center, 0.2f, new Metal(
-                            Vec3(0.5f * (1.0f + r), 0.5f * (1.0f + g), 0.5f * (1.0f + b)),
-                            0.5f * bluriness)));
+
+                const HitableCollection* world = worlds[ThreadPool::currentNode()].get();
+                for (uint i = 0; i < imageWidth; ++i) {
+                    if (!isAdaptivePass) {
+                        for (uint s = 0; s < nbrOfUniformSamples; ++s) {
+                            frameBuffer.addSample(i, j, samplePixel(camera, world, i, j, imageWidth, imageHeight));
+                        }
+                        ThreadPool::countSamples(nbrOfUniformSamples);
+                    }
+                    else if (frameBuffer.standardError(i, j) > errorThreshold) {
+                        for (uint s = 0; s < ADAPTIVE_SAMPLES_PER_PASS; ++s) {
+                            frameBuffer.addSample(i, j, samplePixel(camera, world, i, j, imageWidth, imageHeight));
+                        }
+                        ThreadPool::countSamples(ADAPTIVE_SAMPLES_PER_PASS);
+                    }
                 }
-                else {
-                    //std::cout << "Adding glass sphere" << std::endl;
-                    world->add(new Sphere(center, 0.2f, new Dielectric(1.5f)));
+            });
+        }
+        pool.wait();
+        pass++;
+    }
+
+    return pass;
+}
+
+// Gives the rows that didn't get a single sample (the deadline came during the first pass) the
+// colors of the nearest row that did, so that the image has no black gaps.
+void fillUnsampledRows(FrameBuffer& frameBuffer)
+{
+    const uint imageHeight = frameBuffer.height();
+    std::vector<bool> isSampled(imageHeight);
+    for (uint j = 0; j < imageHeight; ++j) {
+        isSampled[j] = frameBuffer.sampleCount(0, j) > 0;
+    }
+
+    for (uint j = 0; j < imageHeight; ++j) {
+        if (isSampled[j]) {
+            continue;
+        }
+
+        for (uint distance = 1; distance < imageHeight; ++distance) {
+            int source = -1;
+            if (j + distance < imageHeight && isSampled[j + distance]) {
+                source = j + distance;
+            }
+            else if (j >= distance && isSampled[j - distance]) {
+                source = j - distance;
+            }
+
+            if (source >= 0) {
+                for (uint i = 0; i < frameBuffer.width(); ++i) {
+                    frameBuffer.addSample(i, j, frameBuffer.averageColor(i, source));
                 }
+                break;
             }
         }
     }
+}
+
+// Prints the average number of samples per pixel (spp) achieved in each region of the image, top
+// row of regions first, followed by the minimum, average, and maximum spp over the whole image.
+void reportSamplesPerRegion(const FrameBuffer& frameBuffer)
+{
+    uint minSamples = std::numeric_limits<uint>::max();
+    uint maxSamples = 0;
+    unsigned long long totalSamples = 0;
+
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+
+    std::cout << "Samples per pixel by " << REPORT_REGION_SIZE << "x" << REPORT_REGION_SIZE
+              << " region:" << std::endl;
+
+    uint nbrOfRegionRows = (frameBuffer.height() + REPORT_REGION_SIZE - 1) / REPORT_REGION_SIZE;
+    uint nbrOfRegionColumns = (frameBuffer.width() + REPORT_REGION_SIZE - 1) / REPORT_REGION_SIZE;
 
-    world->add(new Sphere(Vec3(0.0f, 1.0f, 0.0f), 1.0f, new Dielectric(1.5f)));
-    world->add(new Sphere(Vec3(-4.0f, 1.0f, 0.0f), 1.0f, new Lambertian(Vec3(0.4f, 0.2f, 0.1f))));
-    world->add(new Sphere(Vec3(4.0f, 1.0f, 0.0f), 1.0f, new Metal(Vec3(0.7f, 0.6f, 0.5f), 0.0f)));
+    for (int regionRow = nbrOfRegionRows - 1; regionRow >= 0; --regionRow) {
+        for (uint regionColumn = 0; regionColumn < nbrOfRegionColumns; ++regionColumn) {
+            uint startI = regionColumn * REPORT_REGION_SIZE;
+            uint startJ = regionRow * REPORT_REGION_SIZE;
+            uint endI = std::min(startI + REPORT_REGION_SIZE, frameBuffer.width());
+            uint endJ = std::min(startJ + REPORT_REGION_SIZE, frameBuffer.height());
+
+            unsigned long long regionSamples = 0;
+            for (uint j = startJ; j < endJ; ++j) {
+                for (uint i = startI; i < endI; ++i) {
+                    uint samples = frameBuffer.sampleCount(i, j);
+                    regionSamples += samples;
+                    minSamples = std::min(minSamples, samples);
+                    maxSamples = std::max(maxSamples, samples);
+                }
+            }
+            totalSamples += regionSamples;
+
+            std::cout << std::setw(8) << std::fixed << std::setprecision(1)
+                      << (double(regionSamples) / ((endI - startI) * (endJ - startJ)));
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << "spp min/avg/max: " << minSamples << " / "
+              << (double(totalSamples) / (frameBuffer.width() * frameBuffer.height())) << " / "
+              << maxSamples << std::endl;
+
+    std::cout.flags(flags);
+    std::cout.precision(precision);
 }
 
 /**
  * Creates a world of spheres with different material properties: diffuse ("normal"), metal, and
  * glass. Ray (path) traces the world and writes the results to a Portable PixMap (.ppm) file.
+ *
+ * Usage: Raytracer [--time-budget seconds | --batch jobFile | --out-of-core directory [--memory-budget MB]]
+ *                  [--world-size cells] [--seed n]
+ *
+ * By default every pixel gets a fixed number of samples. With --time-budget, sample passes are
+ * added until the budget (wall-clock time, measured from startup) runs out, and then the image is
+ * written. With --batch, the world is built once and rendered from every view listed in the job
+ * file (see readBatchViews()) on a shared thread pool. With --out-of-core, the world is written to
+ * the directory as a chunked scene and rendered from there, keeping at most the memory budget's
+ * worth of chunks in memory. --world-size and --seed pick the world generated (the same seed and
+ * size always give the same world; by default the seed is random). An option with an invalid value,
+ * such as a world size of 0 or a budget that isn't a positive number, prints the usage message.
  */
 int main(int argc, const char* argv[])
 {
-    clock_t beginTime = clock();
+    auto beginWallTime = std::chrono::steady_clock::now();
     srand(static_cast<uint>(time(0)));
 
+    double timeBudgetSeconds = 0.0;     // 0 means render a fixed number of samples
+    const char* batchJobPath = nullptr;
+    const char* outOfCoreDirectory = nullptr;
+    double memoryBudgetMB = DEFAULT_MEMORY_BUDGET_MB;
+    uint worldSize = DEFAULT_WORLD_SIZE;
+    uint64_t seed = std::random_device{}();
+    for (int a = 1; a < argc; ++a) {
+        bool isValid = true;
+        if (strcmp(argv[a], "--time-budget") == 0 && a + 1 < argc) {
+            // The budget has to leave some time for rendering after the time held back for writing.
+            isValid = parseNumber(argv[++a], DBL_MIN, MAX_TIME_BUDGET_SECONDS, timeBudgetSeconds) &&
+                      timeBudgetSeconds > FINALIZE_RESERVE_SECONDS;
+        }
+        else if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc) {
+            batchJobPath = argv[++a];
+        }
+        else if (strcmp(argv[a], "--out-of-core") == 0 && a + 1 < argc) {
+            outOfCoreDirectory = argv[++a];
+        }
+        else if (strcmp(argv[a], "--memory-budget") == 0 && a + 1 < argc) {
+            isValid = parseNumber(argv[++a], DBL_MIN, MAX_MEMORY_BUDGET_MB, memoryBudgetMB);
+        }
+        else if (strcmp(argv[a], "--world-size") == 0 && a + 1 < argc) {
+            uint64_t cells = 0;
+            isValid = parseWholeNumber(argv[++a], 1, MAX_WORLD_SIZE, cells);
+            worldSize = uint(cells);
+        }
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) {
+            isValid = parseWholeNumber(argv[++a], 0, UINT64_MAX, seed);
+        }
+        else {
+            isValid = false;
+        }
+
+        if (!isValid) {
+            std::cerr << "Usage: Raytracer [--time-budget seconds | --batch jobFile | "
+                      << "--out-of-core directory [--memory-budget MB]] [--world-size cells] [--seed n]" << std::endl;
+            std::cerr << "  seconds must be a number over " << FINALIZE_RESERVE_SECONDS << ", MB a positive number, "
+                      << "cells a whole number from 1 to " << MAX_WORLD_SIZE << ", and n a whole number" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::vector<BatchView> views;
+    if (batchJobPath != nullptr) {
+        std::ifstream jobFile(batchJobPath);
+        try {
+            if (!jobFile) {
+                throw std::runtime_error("can't open the batch job file");
+            }
+            views = readBatchViews(jobFile);
+        }
+        catch (std::runtime_error& e) {
+            std::cerr << "Raytracer: " << batchJobPath << " " << e.what() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Create the world of spheres.
+    ThreadPool pool;
+    std::cout << "Make world (seed " << seed << ")... " << std::flush;
+    auto worldStartTime = std::chrono::steady_clock::now();
+    std::vector<SphereDescription> spheres = generateRandomWorld(worldSize, seed, pool);
+    std::cout << "World complete (" << spheres.size() << " spheres in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - worldStartTime).count()
+              << " seconds)" << std::endl;
+
+    if (batchJobPath != nullptr) {
+        // Each NUMA node gets its own copy of the world.
+        auto worlds = buildNodeLocalWorlds(pool.topology(), spheres);
+
+        std::cout << "Rendering " << views.size() << " views on " << pool.size() << " threads..." << std::endl;
+        renderBatch(views, worlds, pool);
+        std::cout << "Render complete" << std::endl;
+
+        std::vector<NodeStatistics> nodeStatistics = pool.nodeStatistics();
+        for (uint node = 0; node < nodeStatistics.size(); ++node) {
+            const NodeStatistics& statistics = nodeStatistics[node];
+            std::cout << "Node " << pool.topology().nodeId(node) << ": " << statistics.nbrOfThreads << " threads, "
+                      << statistics.nbrOfSamples << " samples in " << statistics.busySeconds
+                      << " busy seconds (" << statistics.samplesPerSecond() << " samples/second)" << std::endl;
+        }
+
+        std::cout << "Elapsed time: "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - beginWallTime).count()
+                  << " seconds" << std::endl;
+
+        return EXIT_SUCCESS;
+    }
+
     const uint imageWidth = 1200;
     const uint imageHeight = 800;
     const uint nbrOfSamples = 5; // 500;
@@ -135,12 +405,6 @@ int main(int argc, const char* argv[])
     Camera camera(lookFrom, lookAt, Vec3(0.0f, 1.0f, 0.0f), 20.0f, float(imageWidth) / float(imageHeight),
                   aperture, distanceToFocusPlane);
 
-    // Create the world of spheres.
-    std::cout << "Make world... " << std::flush;
-    HitableCollection* world = new HitableCollection();
-    populateRandomWorld(world);
-    std::cout << "World complete" << std::endl;
-
     // Open the the .ppm file.
     std::ofstream imageFile;
     imageFile.exceptions(std::ofstream::failbit | std::ofstream::badbit);
@@ -151,37 +415,116 @@ int main(int argc, const char* argv[])
         std::cerr << "Raytracer: " << IMAGE_PATH << " " << e.what() << " error code: " << e.code() << std::endl;
         exit(EXIT_FAILURE);
     }
-    imageFile << "P3\n" << imageWidth << " " << imageHeight << "\n255\n";
 
-    // Write the ray traced image to the .ppm file.
-    std::cout << "Rendering... " << std::flush;
-    for (int j = imageHeight - 1; j >= 0; --j) {
-        for (int i = 0; i < imageWidth; ++i) {
-            Vec3 color(0.0f, 0.0f, 0.0f);
-            for (int s = 0; s < nbrOfSamples; ++s) {
-                float u = (i + distribution(rndNbrEngine)) / float(imageWidth);
-                float v = (j + distribution(rndNbrEngine)) / float(imageHeight);
-
-                Ray r = camera.calculateRay(u, v);
-                color += calculateColor(r, world, 0);
-            }
-            color /= float(nbrOfSamples);
-            color = Vec3(sqrtf(color[0]), sqrtf(color[1]), sqrtf(color[2]));    // gamma correction
+    if (timeBudgetSeconds > 0.0) {
+        // Render until the deadline, then write whatever the frame buffer holds.
+        auto deadline = beginWallTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(timeBudgetSeconds - FINALIZE_RESERVE_SECONDS));
 
-            int red = int(255.99999f * color[0]);
-            int green = int(255.99999f * color[1]);
-            int blue = int(255.99999f * color[2]);
+        std::cout << "Rendering for " << timeBudgetSeconds << " seconds... " << std::flush;
+        auto worlds = buildNodeLocalWorlds(pool.topology(), spheres);
+        FrameBuffer frameBuffer(imageWidth, imageHeight);
+        uint nbrOfPasses = renderWithinTimeBudget(camera, worlds, frameBuffer, deadline, pool);
+        std::cout << "Render complete (" << nbrOfPasses << " passes)" << std::endl;
 
-            imageFile << red << " " << green << " " << blue << "\n";
+        // The report shows the samples actually taken, before any rows are filled in.
+        reportSamplesPerRegion(frameBuffer);
+        fillUnsampledRows(frameBuffer);
+        frameBuffer.writePPM(imageFile);
+
+        imageFile.close();
+
+        std::cout << "Elapsed time: "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - beginWallTime).count()
+                  << " seconds" << std::endl;
+
+        return EXIT_SUCCESS;
+    }
+
+    if (outOfCoreDirectory != nullptr) {
+        // Write the world out in chunks, then render it one bounce at a time, paging chunks in as
+        // the rays reach them. The world is generated and written in memory; only the render is
+        // held to the memory budget, so the spheres are freed once they are on disk.
+        FrameBuffer frameBuffer(imageWidth, imageHeight);
+        try {
+            writeChunkedScene(spheres, outOfCoreDirectory, SPHERES_PER_CHUNK);
+            std::vector<SphereDescription>().swap(spheres);
+            ChunkCache chunks(outOfCoreDirectory, size_t(memoryBudgetMB * 1024.0 * 1024.0));
+
+            std::cout << "Rendering " << chunks.chunks().size() << " chunks... " << std::flush;
+            uint nbrOfPasses = renderOutOfCore(camera, chunks, frameBuffer, nbrOfSamples, pool);
+            std::cout << "Render complete (" << nbrOfPasses << " passes)" << std::endl;
+
+            ChunkCacheStatistics statistics = chunks.statistics();
+            std::cout << "Chunks: " << statistics.nbrOfRequests << " requests, " << statistics.nbrOfPageIns
+                      << " page-ins (" << statistics.bytesPagedIn << " bytes), " << statistics.nbrOfEvictions
+                      << " evictions, hit rate " << statistics.hitRate() << ", peak resident "
+                      << statistics.peakResidentBytes << " bytes" << std::endl;
         }
+        catch (std::runtime_error& e) {
+            std::cerr << "Raytracer: " << outOfCoreDirectory << " " << e.what() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        frameBuffer.writePPM(imageFile);
+        imageFile.close();
+
+        std::cout << "Elapsed time: "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - beginWallTime).count()
+                  << " seconds" << std::endl;
+
+        return EXIT_SUCCESS;
     }
+
+    // Render rows on the thread pool and stream them through the image writer, which gamma corrects,
+    // encodes, and writes them on its own thread. Each NUMA node renders from its own copy of the
+    // world.
+    auto worlds = buildNodeLocalWorlds(pool.topology(), spheres);
+    ImageWriter imageWriter(imageFile, imageWidth, imageHeight, ROWS_IN_FLIGHT_PER_THREAD * pool.size());
+
+    std::cout << "Rendering... " << std::flush;
+    for (uint row = 0; row < imageHeight; ++row) {
+        pool.submit([&, row] {
+            const HitableCollection* world = worlds[ThreadPool::currentNode()].get();
+            std::vector<float> pixels = imageWriter.acquireRow(row);
+            uint j = imageHeight - 1 - row;
+
+            // Each row is set up as a one row tile.
+            PrimaryRays primaryRays(camera, world, Tile{0, j, imageWidth, j + 1}, imageWidth, imageHeight);
+            std::vector<Vec3> samples;
+            primaryRays.traceRow(j, nbrOfSamples, samples);
+
+            for (uint i = 0; i < imageWidth; ++i) {
+                Vec3 color(0.0f, 0.0f, 0.0f);
+                for (uint s = 0; s < nbrOfSamples; ++s) {
+                    color += samples[i * nbrOfSamples + s];
+                }
+                color /= float(nbrOfSamples);
+
+                pixels[3 * i] = color[0];
+                pixels[3 * i + 1] = color[1];
+                pixels[3 * i + 2] = color[2];
+            }
+
+            imageWriter.submitRow(row, std::move(pixels));
+        });
+    }
+    pool.wait();
     std::cout << "Render complete" << std::endl;
 
-    // Close the file and destroy the world.
-    imageFile.close();
-    delete world;
+    // Wait for the last rows to be written, then close the file.
+    try {
+        imageWriter.finish();
+        imageFile.close();
+    }
+    catch(std::ios_base::failure& e) {
+        std::cerr << "Raytracer: " << IMAGE_PATH << " " << e.what() << " error code: " << e.code() << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
-    std::cout << "Elapsed time: " << (double(clock() - beginTime) / CLOCKS_PER_SEC) << " seconds" << std::endl;
+    std::cout << "Elapsed time: "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - beginWallTime).count()
+              << " seconds" << std::endl;
 
     return EXIT_SUCCESS;
 }